@@ -0,0 +1,126 @@
+#ifndef __AB2_BOUNDED_QUEUE_H_INCLUDED__
+#define __AB2_BOUNDED_QUEUE_H_INCLUDED__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * A bounded lock-free queue for any number of producers and consumers (after
+ * Dmitry Vyukov's bounded MPMC queue). push() and pop() never block and never
+ * allocate; push() fails when the queue is full, pop() when it is empty.
+ *
+ * Each cell carries a sequence number that says whose turn it is: a producer
+ * may fill cell i when its sequence equals the enqueue position, a consumer may
+ * empty it when it equals the dequeue position + 1. Positions are claimed with
+ * a compare and swap, so contention costs a retry, never a wait.
+ *
+ * The capacity is rounded up to a power of two. T must be default constructible
+ * and assignable.
+ */
+template<typename T>
+class BoundedQueue {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param capacity is the minimum number of elements the queue holds
+	 */
+	BoundedQueue( size_t capacity ) {
+		size_t size = 2;
+		while ( size < capacity ) {
+			size <<= 1;
+		}
+
+		_mask = size - 1;
+		_cells.reset( new Cell[size] );
+		for ( size_t i = 0; i < size; i++ ) {
+			_cells[i]._sequence.store( i, std::memory_order_relaxed );
+		}
+		_enqueuePos.store( 0, std::memory_order_relaxed );
+		_dequeuePos.store( 0, std::memory_order_relaxed );
+	}
+
+	/**
+	 * Add an element. Returns false if the queue is full.
+	 */
+	bool push( const T& value ) {
+		Cell* cell;
+		size_t pos = _enqueuePos.load( std::memory_order_relaxed );
+
+		while ( true ) {
+			cell = &_cells[pos & _mask];
+			size_t sequence = cell->_sequence.load( std::memory_order_acquire );
+			intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+			if ( diff == 0 ) {
+				if ( _enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed )) {
+					break;
+				}
+			} else if ( diff < 0 ) {
+				return false;
+			} else {
+				pos = _enqueuePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		cell->_value = value;
+		cell->_sequence.store( pos + 1, std::memory_order_release );
+		return true;
+	}
+
+	/**
+	 * Take the oldest element. Returns false if the queue is empty.
+	 */
+	bool pop( T& value ) {
+		Cell* cell;
+		size_t pos = _dequeuePos.load( std::memory_order_relaxed );
+
+		while ( true ) {
+			cell = &_cells[pos & _mask];
+			size_t sequence = cell->_sequence.load( std::memory_order_acquire );
+			intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+			if ( diff == 0 ) {
+				if ( _dequeuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed )) {
+					break;
+				}
+			} else if ( diff < 0 ) {
+				return false;
+			} else {
+				pos = _dequeuePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		value = std::move( cell->_value );
+		cell->_value = T();
+		cell->_sequence.store( pos + _mask + 1, std::memory_order_release );
+		return true;
+	}
+
+	/**
+	 * Returns the number of elements the queue holds.
+	 */
+	size_t getCapacity() const {
+		return _mask + 1;
+	}
+
+private:
+
+	struct Cell {
+		std::atomic<size_t> _sequence;
+		T _value;
+	};
+
+	std::unique_ptr<Cell[]> _cells;
+	size_t _mask;
+
+	// on their own cache lines, producers and consumers don't share one
+	alignas(64) std::atomic<size_t> _enqueuePos;
+	alignas(64) std::atomic<size_t> _dequeuePos;
+};
+
+#endif // __AB2_BOUNDED_QUEUE_H_INCLUDED__
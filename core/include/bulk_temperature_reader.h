@@ -0,0 +1,57 @@
+#ifndef __AB2_BULK_TEMPERATURE_READER_H_INCLUDED__
+#define __AB2_BULK_TEMPERATURE_READER_H_INCLUDED__
+
+#include <vector>
+
+#include <roller/core/types.h>
+#include <roller/core/string_id.h>
+
+using namespace roller;
+
+/**
+ * One probe's result from a bulk read.
+ */
+struct BulkSample {
+	bool _valid = false; // false if the probe could not be read
+	i32 _temp = 0; // milli C
+	i64 _time = 0; // ms
+};
+
+/**
+ * Reads every probe of one devman temperature sensor manager in a single pass,
+ * e.g. by starting a conversion on all probes of a 1-Wire bus at once and then
+ * reading them all, rather than converting and reading one probe at a time.
+ *
+ * TemperatureManager uses a BulkTemperatureReader, if one is registered for a
+ * probe's manager, instead of reading the probe on its own.
+ */
+class BulkTemperatureReader {
+
+public:
+
+	/**
+	 * Destructor
+	 */
+	virtual ~BulkTemperatureReader() {}
+
+	/**
+	 * Read the given probes. Throws if nothing could be read at all.
+	 *
+	 * @param sensorIds are the ids of the probes to read
+	 * @param samples is resized to match sensorIds and filled with the result
+	 *		of each probe, in the same order; probes that could not be read are
+	 *		left invalid
+	 */
+	virtual void readAll( const std::vector<StringId>& sensorIds, std::vector<BulkSample>& samples ) = 0;
+
+	/**
+	 * Request the given resolution for a probe's future conversions. Readers
+	 * that can't change the resolution ignore it. Must be threadsafe.
+	 *
+	 * @param sensorId is the id of the probe
+	 * @param bits is the resolution, e.g. 9 to 12 for a DS18B20
+	 */
+	virtual void setResolution( const StringId& sensorId, i32 bits ) {}
+};
+
+#endif // __AB2_BULK_TEMPERATURE_READER_H_INCLUDED__
@@ -3,6 +3,10 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <functional>
+
+#include <roller/core/indexed_container.h>
 
 #include <json.hpp>
 
@@ -50,6 +54,13 @@
  * circuit breakers, FCGIs, etc. and should also be adequate for avoiding thermal
  * issues related to wiring insulation, etc.
  *
+ * <b>Pin listeners</b>
+ *
+ * Pin listeners are notified whenever a pin is enabled or disabled (i.e. its
+ * desired state changes), e.g. so control loops can anticipate a pump starting.
+ * They are called from the thread that enabled or disabled the pin, without
+ * the CurrentLimiter's lock held, so they may call back into it.
+ *
  * If instantaneous limits are absolutely required, consider that the maximum
  * instantaneous load permited by the CurrentLimiter will be the sum of all
  * enabled non-PWM pins as well as all enabled PWM pins as though they were set
@@ -58,6 +69,11 @@
 class CurrentLimiter {
 
 public:
+
+	/**
+	 * Called when a pin is enabled or disabled.
+	 */
+	typedef std::function<void(uint32_t pin, bool enabled)> PinListener;
 	
 	/**
 	 * This structure represents a pin configuration.
@@ -117,9 +133,10 @@ public:
 	PinConfiguration getPinConfiguration(uint32_t pin);
 
 	/**
-	 * Returns the pin state for the given pin
+	 * Returns a copy of the pin state for the given pin, taken under the lock
+	 * (the pin listeners change it from other threads)
 	 */
-	const PinState& getPinState(uint32_t pin);
+	PinState getPinState(uint32_t pin);
 
 	/**
 	 * Update a pin configuration
@@ -146,6 +163,24 @@ public:
 	 */
 	bool isEnabled(uint32_t pin);
 
+	/**
+	 * Returns the current (mA) left for the given PWM pins: the max current
+	 * less the base current, the enabled critical pins and the desired loads
+	 * of all other PWM pins. This is the budget a planner can divide among the
+	 * given pins without the limiter scaling anything back.
+	 */
+	uint32_t getAvailableMilliAmps(const std::set<uint32_t>& pins);
+
+	/**
+	 * Add a pin listener
+	 */
+	Key addPinListener(const PinListener& listener);
+
+	/**
+	 * Remove a pin listener
+	 */
+	void removePinListener(const Key& key);
+
 	/**
 	 * Convert to json
 	 */
@@ -159,6 +194,14 @@ private:
 	uint32_t _baseMilliAmps = 0;
 	uint32_t _maxMilliAmps = 0;
 
+	Mutex _listenerLock;
+	IndexedContainer<PinListener> _pinListeners;
+
+	/**
+	 * Notify the pin listeners. Must not be called with _lock held.
+	 */
+	void firePinChangedEvent(uint32_t pin, bool enabled);
+
 	/**
 	 * Evaluate the pin configurations and override any as necessary.
 	 *
@@ -0,0 +1,93 @@
+#ifndef __AB2_DISTURBANCE_COMPENSATOR_H_INCLUDED__
+#define __AB2_DISTURBANCE_COMPENSATOR_H_INCLUDED__
+
+#include <map>
+#include <string>
+
+#include <roller/core/types.h>
+
+#include <json.hpp>
+
+using namespace roller;
+
+/**
+ * How a control loop reacts to a known disturbance (e.g. a pump starting).
+ */
+struct DisturbanceRule {
+	std::string _source; // "p1", "p2", "valve_float", ...
+	f32 _bump = 0.0f; // feed-forward added to the output at the event, in output units
+	f32 _duration = 0.0f; // s, over which the bump and gain scale decay back to nothing
+	f32 _gainScale = 1.0f; // multiplier on the P and D terms at the event
+};
+
+/**
+ * Feed-forward for known step disturbances. When a source fires (trigger()),
+ * its rule's bump and gain scale apply right away and then decay linearly over
+ * the rule's duration, so the loop reacts before the probe sees the disturbance
+ * and hands back to the PID as it catches up.
+ *
+ * If a source fires again while active, it restarts. Bumps of several active
+ * sources add up; gain scales multiply.
+ *
+ * Not threadsafe; the owner is expected to lock.
+ */
+class DisturbanceCompensator {
+
+public:
+
+	/**
+	 * Add or replace the rule for a source.
+	 */
+	void setRule( const DisturbanceRule& rule );
+
+	/**
+	 * Remove the rule for a source, if any. Ends its disturbance.
+	 */
+	void removeRule( const std::string& source );
+
+	/**
+	 * Returns the rules, keyed by source.
+	 */
+	const std::map<std::string, DisturbanceRule>& getRules() const;
+
+	/**
+	 * A disturbance from the given source just happened. Ignored if there is no
+	 * rule for the source.
+	 */
+	void trigger( const std::string& source );
+
+	/**
+	 * Advance active disturbances by dt (s).
+	 */
+	void update( f32 dt );
+
+	/**
+	 * Returns the current feed-forward bump, in output units.
+	 */
+	f32 getBump() const;
+
+	/**
+	 * Returns the current gain scale.
+	 */
+	f32 getGainScale() const;
+
+	/**
+	 * Returns true if any disturbance is active.
+	 */
+	bool isActive() const;
+
+private:
+
+	/**
+	 * Returns how much (1-0) of the given source's disturbance remains.
+	 */
+	f32 getRemaining( const std::string& source ) const;
+
+	std::map<std::string, DisturbanceRule> _rules;
+	std::map<std::string, f32> _elapsed; // s since each active source fired
+};
+
+void to_json(nlohmann::json& j, const DisturbanceRule& rule);
+void to_json(nlohmann::json& j, const DisturbanceCompensator& compensator);
+
+#endif // __AB2_DISTURBANCE_COMPENSATOR_H_INCLUDED__
@@ -0,0 +1,96 @@
+#ifndef __AB2_GAIN_SCHEDULE_H_INCLUDED__
+#define __AB2_GAIN_SCHEDULE_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include <roller/core/types.h>
+
+#include <json.hpp>
+
+using namespace roller;
+
+/**
+ * One row of a GainSchedule: the PID tuning to use at a given operating point.
+ */
+struct GainScheduleEntry {
+	f32 _operatingPoint = 0.0f;
+	f32 _kp = 0.0f;
+	f32 _ki = 0.0f;
+	f32 _kd = 0.0f;
+	f32 _errorAccumulationCap = 0.0f;
+};
+
+/**
+ * Gain schedule for a PID. A table of PID tunings keyed on an operating point
+ * (either the setpoint or the measured input). Tunings between entries are
+ * linearly interpolated; outside the table the nearest entry is used.
+ */
+class GainSchedule {
+
+public:
+
+	/**
+	 * What the operating point of the schedule is taken from.
+	 */
+	enum class Key {
+		SETPOINT,
+		INPUT
+	};
+
+	/**
+	 * Constructor. Creates an empty schedule.
+	 */
+	GainSchedule( Key key = Key::SETPOINT );
+
+	/**
+	 * Add an entry. Entries are kept sorted by operating point; an entry at an
+	 * existing operating point replaces it.
+	 */
+	void addEntry( const GainScheduleEntry& entry );
+
+	/**
+	 * Remove all entries.
+	 */
+	void clear();
+
+	/**
+	 * Returns true if there are no entries.
+	 */
+	bool isEmpty() const;
+
+	/**
+	 * Returns the Key
+	 */
+	Key getKey() const;
+
+	/**
+	 * Returns the entries, sorted by operating point.
+	 */
+	const std::vector<GainScheduleEntry>& getEntries() const;
+
+	/**
+	 * Returns the (interpolated) tuning for the given operating point. The
+	 * schedule must not be empty.
+	 */
+	GainScheduleEntry lookup( f32 operatingPoint ) const;
+
+	/**
+	 * Parse a schedule from a string of comma separated entries, each of which
+	 * is colon separated "operatingPoint:kp:ki:kd:errorAccumulationCap".
+	 *
+	 * e.g. "40:15:1:3:1.5,100:25:0.5:3:3"
+	 */
+	static GainSchedule parse( const std::string& table, Key key );
+
+private:
+
+	Key _key;
+	std::vector<GainScheduleEntry> _entries;
+};
+
+void to_json(nlohmann::json& j, const GainScheduleEntry& entry);
+void to_json(nlohmann::json& j, const GainSchedule::Key& key);
+void to_json(nlohmann::json& j, const GainSchedule& schedule);
+
+#endif // __AB2_GAIN_SCHEDULE_H_INCLUDED__
@@ -0,0 +1,126 @@
+#ifndef __AB2_HEAT_UP_PLANNER_H_INCLUDED__
+#define __AB2_HEAT_UP_PLANNER_H_INCLUDED__
+
+#include <vector>
+
+#include <roller/core/types.h>
+
+#include <json.hpp>
+
+#include "thermal_model.h"
+
+using namespace roller;
+
+/**
+ * A vessel as seen by the HeatUpPlanner.
+ */
+struct PlannerVessel {
+	ThermalModel _model = ThermalModel( 0.0f, 0.0f, 0.0f, 0.0f );
+	f32 _temp = 0.0f; // C, measured
+	f32 _target = 0.0f; // C
+	f32 _milliAmps = 0.0f; // element current at full load
+};
+
+/**
+ * The plan for one vessel over the next step.
+ */
+struct PlannedLoad {
+	f32 _load = 0.0f; // 0-1
+	bool _holding = false; // at target, only needs to hold it
+	f32 _eta = 0.0f; // s, predicted time to reach target (-1 if unreachable)
+};
+
+/**
+ * Model predictive heat-up planner for several vessels sharing one current budget.
+ *
+ * Every time plan() is called, the planner searches over the ways to split the
+ * budget between the vessels that are still heating (on a grid of the given
+ * resolution). Each split is simulated over the horizon with the vessels'
+ * ThermalModels:
+ *
+ * - a vessel never gets more than the load that brings it exactly to its
+ *		target at the end of a step, so the plan never overshoots
+ * - once a vessel reaches its target it only takes its holding load and the
+ *		rest of its share goes to the vessels still heating
+ *
+ * The split with the lowest cost (time until all vessels are at target, plus
+ * a small weight on the sum of the individual times) wins and its first step
+ * is returned. Calling plan() again with fresh temperatures makes it a
+ * receding horizon controller.
+ *
+ * Compared to proportional scaling in the CurrentLimiter, this gives the
+ * budget to whichever vessel benefits most, instead of throttling both.
+ */
+class HeatUpPlanner {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param stepDuration is the duration (s) of one planning step
+	 * @param horizonSteps is the number of steps to simulate
+	 * @param splitResolution is the number of increments the budget is divided into
+	 */
+	HeatUpPlanner( f32 stepDuration = 30.0f, i32 horizonSteps = 120, i32 splitResolution = 20 );
+
+	/**
+	 * Plan the loads of the given vessels for the next step.
+	 *
+	 * @param vessels are the vessels to plan for
+	 * @param availableMilliAmps is the current budget shared by their elements
+	 * @return one PlannedLoad per vessel, in order
+	 */
+	std::vector<PlannedLoad> plan( const std::vector<PlannerVessel>& vessels, f32 availableMilliAmps ) const;
+
+	/**
+	 * Sets HoldingTolerance (C). A vessel within this of its target is holding.
+	 */
+	void setHoldingTolerance( f32 holdingTolerance );
+
+	/**
+	 * Returns HoldingTolerance (C)
+	 */
+	f32 getHoldingTolerance() const;
+
+	/**
+	 * Returns StepDuration (s)
+	 */
+	f32 getStepDuration() const;
+
+	/**
+	 * Returns HorizonSteps
+	 */
+	i32 getHorizonSteps() const;
+
+private:
+
+	/**
+	 * Returns the loads for one step, given each heating vessel's share of the budget.
+	 */
+	void allocate(
+			const std::vector<PlannerVessel>& vessels,
+			const std::vector<f32>& temps,
+			const std::vector<bool>& holding,
+			const std::vector<f32>& shares,
+			f32 availableMilliAmps,
+			std::vector<f32>& loads ) const;
+
+	/**
+	 * Simulate a split over the horizon. Returns its cost and fills in the ETAs.
+	 */
+	f32 simulate(
+			const std::vector<PlannerVessel>& vessels,
+			const std::vector<f32>& shares,
+			f32 availableMilliAmps,
+			std::vector<f32>& etas ) const;
+
+	f32 _stepDuration;
+	i32 _horizonSteps;
+	i32 _splitResolution;
+	f32 _holdingTolerance;
+};
+
+void to_json(nlohmann::json& j, const PlannedLoad& plannedLoad);
+
+#endif // __AB2_HEAT_UP_PLANNER_H_INCLUDED__
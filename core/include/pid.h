@@ -4,6 +4,8 @@
 #include <roller/core/types.h>
 #include <roller/core/ring_buffer.h>
 
+#include "gain_schedule.h"
+
 using namespace roller;
 
 /**
@@ -32,6 +34,101 @@ public:
 	 */
 	f32 getOutput();
 
+	/**
+	 * Report the output that was actually applied for the last update(). This is
+	 * used for back-calculation anti-windup: the difference between the applied
+	 * output and the unclamped output computed by update() is bled from the
+	 * integrator on the next update().
+	 *
+	 * If this is never called, the clamped output is assumed to have been applied.
+	 *
+	 * @param appliedOutput is the applied output, in the same units as the PID output
+	 */
+	void setAppliedOutput( f32 appliedOutput );
+
+	/**
+	 * Sets TrackingGain. This is the back-calculation gain (1/Tt) used to bleed the
+	 * integrator when the applied output differs from the computed output. Zero
+	 * (the default) disables back-calculation; only enable it if the applied
+	 * output is reported through setAppliedOutput().
+	 *
+	 * @param trackingGain is the new value for TrackingGain
+	 */
+	void setTrackingGain( f32 trackingGain );
+
+	/**
+	 * Returns TrackingGain
+	 *
+	 * @return TrackingGain
+	 */
+	f32 getTrackingGain() const;
+
+	/**
+	 * Sets GainScale. The proportional and derivative terms are multiplied by
+	 * it, on top of the tunings (or gain schedule). Used to make the loop more
+	 * aggressive for a while, e.g. after a known disturbance. Defaults to 1.
+	 *
+	 * @param gainScale is the new value for GainScale
+	 */
+	void setGainScale( f32 gainScale );
+
+	/**
+	 * Returns GainScale
+	 *
+	 * @return GainScale
+	 */
+	f32 getGainScale() const;
+
+	/**
+	 * Change the tuning parameters. The change is bumpless: the accumulated error
+	 * is rescaled so that the integral term is unchanged by a change in ki.
+	 */
+	void setTunings( f32 kp, f32 ki, f32 kd );
+
+	/**
+	 * Returns Kp
+	 */
+	f32 getKp() const;
+
+	/**
+	 * Returns Ki
+	 */
+	f32 getKi() const;
+
+	/**
+	 * Returns Kd
+	 */
+	f32 getKd() const;
+
+	/**
+	 * Sets the GainSchedule. When the schedule is not empty, the tuning parameters
+	 * and ErrorAccumulationCap are looked up from it (bumplessly) on every update(),
+	 * keyed on the setpoint or input as configured by the schedule.
+	 *
+	 * An empty schedule leaves the current tuning in place.
+	 */
+	void setGainSchedule( const GainSchedule& gainSchedule );
+
+	/**
+	 * Returns the GainSchedule
+	 */
+	const GainSchedule& getGainSchedule() const;
+
+	/**
+	 * Sets FeedForward. The feed-forward term is added to the PID terms before the
+	 * output is clamped, so the PID only needs to correct the residual.
+	 *
+	 * @param feedForward is the new value for FeedForward, in the same units as the PID output
+	 */
+	void setFeedForward( f32 feedForward );
+
+	/**
+	 * Returns FeedForward
+	 *
+	 * @return FeedForward
+	 */
+	f32 getFeedForward() const;
+
 	/**
 	 * Sets ErrorAccumulationCap
 	 *
@@ -70,10 +167,16 @@ private:
 	f32 _minOutput;
 	f32 _maxOutput;
 	f32 _errorAccumulationCap;
+	f32 _trackingGain;
+	f32 _gainScale;
+	GainSchedule _gainSchedule;
 
 	// state
+	f32 _feedForward;
 	f32 _lastInput;
 	f32 _output;
+	f32 _unclampedOutput;
+	f32 _appliedOutput;
 	f32 _errorSum;
 	RingBuffer<f32> _inputAccumulation;
 };
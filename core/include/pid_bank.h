@@ -0,0 +1,139 @@
+#ifndef __AB2_PID_BANK_H_INCLUDED__
+#define __AB2_PID_BANK_H_INCLUDED__
+
+#include <vector>
+
+#include <roller/core/types.h>
+
+using namespace roller;
+
+#define AB_PID_BANK_HISTORY_SIZE 64 // must match PID's input accumulation
+
+/**
+ * A bank of PID controllers updated together.
+ *
+ * All loop state is stored structure-of-arrays, and update() advances every
+ * loop in a single pass using SIMD when available (AVX or SSE2 on x86, NEON on
+ * ARM) with a scalar fallback. Each loop behaves like a PID with the same
+ * parameters, feed-forward, gain scale and applied output, and produces the
+ * same output as PID::update() within float tolerance.
+ *
+ * Unlike PID, loops in a bank have no gain schedule; use setTunings() instead.
+ *
+ * Loops are addressed by the index returned from add(). Not threadsafe.
+ */
+class PIDBank {
+
+public:
+
+	/**
+	 * Constructor. Creates an empty bank.
+	 */
+	PIDBank();
+
+	/**
+	 * Add a loop. Takes the same parameters as the PID constructor. Returns the
+	 * index of the new loop.
+	 */
+	size_t add( f32 kp, f32 ki, f32 kd, f32 setpoint, f32 minOutput, f32 maxOutput );
+
+	/**
+	 * Returns the number of loops
+	 */
+	size_t size() const;
+
+	/**
+	 * Update every loop. Same as calling PID::update() on each loop.
+	 *
+	 * @param inputs holds one input per loop (size() entries)
+	 * @param dt is the change in time since the last update, in seconds
+	 */
+	void update( const f32* inputs, f32 dt );
+
+	/**
+	 * Returns the output of the given loop
+	 */
+	f32 getOutput( size_t loop ) const;
+
+	/**
+	 * Returns the outputs of all loops (size() entries)
+	 */
+	const f32* getOutputs() const;
+
+	/**
+	 * Same as PID::setAppliedOutput() for the given loop
+	 */
+	void setAppliedOutput( size_t loop, f32 appliedOutput );
+
+	/**
+	 * Same as PID::setTunings() for the given loop
+	 */
+	void setTunings( size_t loop, f32 kp, f32 ki, f32 kd );
+
+	/**
+	 * Same as PID::setSetpoint() for the given loop
+	 */
+	void setSetpoint( size_t loop, f32 setpoint );
+
+	/**
+	 * Same as PID::setFeedForward() for the given loop
+	 */
+	void setFeedForward( size_t loop, f32 feedForward );
+
+	/**
+	 * Same as PID::setErrorAccumulationCap() for the given loop
+	 */
+	void setErrorAccumulationCap( size_t loop, f32 errorAccumulationCap );
+
+	/**
+	 * Same as PID::setTrackingGain() for the given loop
+	 */
+	void setTrackingGain( size_t loop, f32 trackingGain );
+
+	/**
+	 * Same as PID::setGainScale() for the given loop
+	 */
+	void setGainScale( size_t loop, f32 gainScale );
+
+	/**
+	 * Returns the name of the update implementation compiled in:
+	 * "avx", "sse", "neon" or "scalar"
+	 */
+	static const char* getImplementation();
+
+private:
+
+	/**
+	 * Grow the arrays to hold at least the given number of loops. Storage is
+	 * padded to a multiple of the SIMD width; padding lanes are inert.
+	 */
+	void reserve( size_t loops );
+
+	size_t _size;
+	size_t _stride;
+
+	// config
+	std::vector<f32> _kp;
+	std::vector<f32> _ki;
+	std::vector<f32> _kd;
+	std::vector<f32> _setpoint;
+	std::vector<f32> _minOutput;
+	std::vector<f32> _maxOutput;
+	std::vector<f32> _errorAccumulationCap;
+	std::vector<f32> _trackingGain;
+	std::vector<f32> _gainScale;
+
+	// state
+	std::vector<f32> _feedForward;
+	std::vector<f32> _lastInput;
+	std::vector<f32> _output;
+	std::vector<f32> _unclampedOutput;
+	std::vector<f32> _appliedOutput;
+	std::vector<f32> _errorSum;
+	std::vector<f32> _input;		// padded copy of the inputs
+	std::vector<f32> _historyCount;	// number of filled history slots per loop
+	std::vector<f32> _history;		// AB_PID_BANK_HISTORY_SIZE rows of _stride entries
+	size_t _historyIndex;
+};
+
+#endif // __AB2_PID_BANK_H_INCLUDED__
@@ -0,0 +1,196 @@
+#ifndef __AB2_PROBE_BUS_H_INCLUDED__
+#define __AB2_PROBE_BUS_H_INCLUDED__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <roller/core/types.h>
+#include <roller/core/string_id.h>
+#include <roller/core/thread.h>
+
+#include <json.hpp>
+
+#include "hw_manager.h"
+#include "bulk_temperature_reader.h"
+#include "probe_handle.h"
+#include "probe_reader.h"
+
+using namespace roller;
+
+/**
+ * A probe as a ProbeBus reads it: resolved once, so a sweep needs no lookups.
+ */
+struct BusProbe {
+	ProbeHandle _handle;
+	StringId _id;
+	std::shared_ptr<devman::TemperatureSensor> _sensor; // may be null if it could not be resolved
+	bool _background; // read without holding up the sweep (see ProbeBus)
+};
+
+/**
+ * Sweep metrics of a ProbeBus.
+ */
+struct BusStats {
+	StringId _id;
+	i32 _numProbes = 0;
+	i64 _numSweeps = 0;
+	i64 _numSkippedSweeps = 0; // sweeps requested while the last was still running
+	i64 _numTimeouts = 0;
+	i64 _lastSweep = 0; // ms, when the last sweep finished
+	i64 _lastSweepDuration = 0; // ms
+	i64 _maxSweepDuration = 0; // ms
+	f32 _avgSweepDuration = 0.0f; // ms, exponential moving average
+};
+
+/**
+ * Reads the probes of one devman temperature sensor manager (one 1-Wire
+ * adapter / bus) on a dedicated worker thread, so a slow bus never delays the
+ * probes of another.
+ *
+ * The reads themselves run on a long lived ProbeReader, which the worker waits
+ * on for up to the read timeout per read (or per bulk read). A read that times
+ * out is abandoned along with its reader, which is replaced, so a hung probe
+ * costs at most one timeout per sweep. A probe whose abandoned read is still
+ * hung is skipped (counted as an error) until that read returns.
+ *
+ * Probes marked _background (probes that keep failing) are read through devman
+ * on a second ProbeReader that the sweep doesn't wait for, even with a bulk
+ * reader; the first sweep after a read returns hands its result on. So a
+ * broken probe costs the others nothing.
+ *
+ * Results are handed to a callback as they come in, from the worker thread.
+ */
+class ProbeBus {
+
+public:
+
+	/**
+	 * Called with the result of each read, and when (ms) the read was issued
+	 * (0 if it never was). A sweep's reads are issued when the sweep is
+	 * requested, so their wait behind the probes ahead of them counts; a
+	 * background read is issued when its reader starts it.
+	 */
+	typedef std::function<void(ProbeHandle handle, bool success, i32 temp, i64 time, i64 issued, const std::string& error)> ReadingCallback;
+
+	/**
+	 * Constructor. Starts the worker thread.
+	 *
+	 * @param managerId is the id of the devman temperature sensor manager
+	 * @param callback is called with the result of each read
+	 */
+	ProbeBus( const StringId& managerId, const ReadingCallback& callback );
+
+	/**
+	 * Destructor. Stops and joins the worker thread.
+	 */
+	~ProbeBus();
+
+	/**
+	 * Sets the probes on the bus (for the stats; each sweep reads the probes
+	 * it is asked to).
+	 */
+	void setProbes( const std::vector<StringId>& sensorIds );
+
+	/**
+	 * Sets a BulkTemperatureReader to read all probes at once, or nullptr to
+	 * read them one at a time.
+	 */
+	void setBulkReader( const std::shared_ptr<BulkTemperatureReader>& reader );
+
+	/**
+	 * Sets the read timeout (ms). Applies to each read, or to a whole bulk read.
+	 */
+	void setReadTimeout( i32 readTimeout );
+
+	/**
+	 * Ask the worker to read the given probes, in order. Returns false (and
+	 * counts a skipped sweep) if the previous sweep has not finished yet.
+	 */
+	bool requestSweep( const std::vector<BusProbe>& probes );
+
+	/**
+	 * Stop the worker thread. Does not wait for it; see the destructor.
+	 */
+	void stop();
+
+	/**
+	 * Returns the sweep metrics.
+	 */
+	BusStats getStats() const;
+
+private:
+
+	/**
+	 * Worker thread entry point
+	 */
+	void run();
+
+	/**
+	 * Read every probe once
+	 */
+	void sweep();
+
+	/**
+	 * Run a read on the reader and wait up to the read timeout for it. Returns
+	 * false if it failed or timed out; on a timeout the read is kept in hung
+	 * and the reader replaced. The read is skipped (and false returned) if the
+	 * read kept in hung is still running.
+	 */
+	bool runWithTimeout( std::shared_ptr<ProbeReader::Job>& hung, const std::function<void()>& read, std::string& error );
+
+	/**
+	 * A read in the background, and its sample once the job is done.
+	 */
+	struct BackgroundRead {
+		std::shared_ptr<ProbeReader::Job> _job;
+		BulkSample _sample;
+	};
+
+	/**
+	 * Queue a background read of a probe, unless its last one hasn't finished
+	 * yet (which counts as a failed read).
+	 */
+	void startBackgroundRead( const BusProbe& probe );
+
+	/**
+	 * Hand the results of finished background reads to the callback, and
+	 * replace the background reader if its read has timed out.
+	 */
+	void collectBackgroundReads();
+
+	StringId _managerId;
+	ReadingCallback _callback;
+
+	mutable std::mutex _lock;
+	std::condition_variable _condition;
+	bool _running;
+	bool _sweepRequested;
+	i64 _sweepRequestedAt; // ms
+	bool _sweeping;
+	std::vector<BusProbe> _sweepProbes; // the probes of the requested sweep
+	std::shared_ptr<BulkTemperatureReader> _bulkReader;
+	i32 _readTimeout;
+	BusStats _stats;
+
+	// worker thread only
+	std::unique_ptr<ProbeReader> _reader;
+	std::unique_ptr<ProbeReader> _backgroundReader;
+
+	// reads that timed out and have not returned yet, by probe handle, and the bulk read
+	std::vector<std::shared_ptr<ProbeReader::Job>> _hungReads;
+	std::shared_ptr<ProbeReader::Job> _hungBulkRead;
+
+	// background reads that have not been collected yet, by probe handle
+	std::vector<std::shared_ptr<BackgroundRead>> _backgroundReads;
+
+	Thread _thread;
+};
+
+void to_json(nlohmann::json& j, const BusStats& stats);
+
+#endif // __AB2_PROBE_BUS_H_INCLUDED__
@@ -0,0 +1,17 @@
+#ifndef __AB2_PROBE_HANDLE_H_INCLUDED__
+#define __AB2_PROBE_HANDLE_H_INCLUDED__
+
+#include <roller/core/types.h>
+
+using namespace roller;
+
+/**
+ * A small integer naming a probe known to a TemperatureManager: the index of
+ * its entry. A probe keeps its handle for the life of the manager, including
+ * when it disappears and is discovered again.
+ */
+typedef i32 ProbeHandle;
+
+#define AB_INVALID_PROBE_HANDLE -1
+
+#endif // __AB2_PROBE_HANDLE_H_INCLUDED__
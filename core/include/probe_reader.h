@@ -0,0 +1,104 @@
+#ifndef __AB2_PROBE_READER_H_INCLUDED__
+#define __AB2_PROBE_READER_H_INCLUDED__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <roller/core/types.h>
+
+using namespace roller;
+
+/**
+ * A long lived thread that runs a ProbeBus's reads one at a time, in the order
+ * they are posted.
+ *
+ * A read that hangs can't be interrupted, so instead the reader running it is
+ * given up on: destroying a reader in the middle of a read leaves its thread to
+ * finish that read and exit, and the bus carries on with a new reader. The
+ * thread only touches state it shares ownership of, so it can outlive the
+ * reader.
+ */
+class ProbeReader {
+
+public:
+
+	/**
+	 * A read, and its outcome once _done.
+	 */
+	struct Job {
+		Job( const std::function<void()>& read ) : _read(read), _done(false), _started(0) {}
+
+		std::function<void()> _read;
+		std::atomic_bool _done;
+		i64 _started; // ms, when the reader started the read; set before _done
+		std::string _error; // empty if the read succeeded; set before _done
+	};
+
+	/**
+	 * Constructor. Starts the thread.
+	 */
+	ProbeReader();
+
+	/**
+	 * Destructor. Stops the thread and joins it, unless it is in the middle of
+	 * a read, which it is left to finish. Reads that haven't started fail.
+	 */
+	~ProbeReader();
+
+	/**
+	 * Queue a read.
+	 */
+	std::shared_ptr<Job> post( const std::function<void()>& read );
+
+	/**
+	 * Queue a job taken from another reader (see takeQueued()).
+	 */
+	void post( const std::shared_ptr<Job>& job );
+
+	/**
+	 * Wait up to the given time (ms) for a job to finish. Returns false if it
+	 * hasn't.
+	 */
+	bool wait( const std::shared_ptr<Job>& job, i32 timeout );
+
+	/**
+	 * Returns when (ms) the read in progress started, or 0 if there is none.
+	 */
+	i64 getBusySince() const;
+
+	/**
+	 * Take the jobs that haven't started, e.g. to post them to a reader that
+	 * replaces this one.
+	 */
+	std::vector<std::shared_ptr<Job>> takeQueued();
+
+private:
+
+	/**
+	 * What the reader shares with its thread.
+	 */
+	struct State {
+		mutable std::mutex _lock;
+		std::condition_variable _condition;
+		std::deque<std::shared_ptr<Job>> _jobs;
+		bool _stopping = false;
+		i64 _busySince = 0; // ms
+	};
+
+	/**
+	 * Thread entry point
+	 */
+	static void run( std::shared_ptr<State> state );
+
+	std::shared_ptr<State> _state;
+	std::thread _thread;
+};
+
+#endif // __AB2_PROBE_READER_H_INCLUDED__
@@ -0,0 +1,113 @@
+#ifndef __AB2_SAMPLE_FILTER_H_INCLUDED__
+#define __AB2_SAMPLE_FILTER_H_INCLUDED__
+
+#include <roller/core/types.h>
+
+using namespace roller;
+
+/**
+ * Limits of a physically possible probe sample. Temperatures are in the units
+ * of ProbeStats::_lastTemp (mC).
+ */
+struct SampleFilterSettings {
+	i32 _minTemp = -55000; // the DS18B20's range
+	i32 _maxTemp = 125000;
+	i32 _maxStep = 2000; // how far a sample may move from the last accepted one, plus...
+	i32 _maxRate = 2000; // ...this much per second since it (mC / s)
+	i32 _maxRejections = 3; // consecutive rejections after which the filter starts over
+};
+
+/**
+ * The ingest stage of a probe's samples: rejects samples that can't be real and
+ * smooths the rest with a median of 3, which removes a single spike. On a steady
+ * ramp the median is the middle sample, so the filtered value lags one sample
+ * behind; it is reported with the time of the sample it came from.
+ *
+ * A sample is rejected if it is out of range, if it is the DS18B20's power-on
+ * value (85 C) while the probe was not near 85 C, or if it moved from the last
+ * accepted sample faster than the settings allow. An 85 C first sample is held
+ * back until the next sample confirms it. If samples keep being rejected, the
+ * change is taken to be real (e.g. the probe moved to another vessel) and the
+ * filter starts over from the next sample in range.
+ *
+ * Not threadsafe.
+ */
+class SampleFilter {
+
+public:
+
+	/**
+	 * The outcome of a sample.
+	 */
+	enum class Result {
+		ACCEPTED,
+		OUT_OF_RANGE,
+		POWER_ON_VALUE,
+		TOO_FAST
+	};
+
+	/**
+	 * Constructor.
+	 */
+	SampleFilter( const SampleFilterSettings& settings = SampleFilterSettings() );
+
+	/**
+	 * Forget all samples.
+	 */
+	void reset();
+
+	/**
+	 * Add a sample.
+	 *
+	 * @param temp is the sample (mC)
+	 * @param time is the time of the sample (ms)
+	 * @return ACCEPTED, or why the sample was rejected
+	 */
+	Result add( i32 temp, i64 time );
+
+	/**
+	 * Returns the filtered temperature (mC), as of the last accepted sample.
+	 * Only meaningful once a sample has been accepted.
+	 */
+	i32 getFiltered() const;
+
+	/**
+	 * Returns the time of the sample getFiltered() came from (ms). With a
+	 * median this is not always the newest sample, and can be older than the
+	 * one returned after the previous sample.
+	 */
+	i64 getFilteredTime() const;
+
+	/**
+	 * Sets the Settings. Takes effect from the next sample.
+	 */
+	void setSettings( const SampleFilterSettings& settings );
+
+	/**
+	 * Returns the Settings.
+	 */
+	const SampleFilterSettings& getSettings() const;
+
+	/**
+	 * Returns a name for a result.
+	 */
+	static const char* getResultName( Result result );
+
+private:
+
+	SampleFilterSettings _settings;
+
+	i32 _samples[3]; // the last accepted samples
+	i64 _times[3]; // ms, of _samples
+	i32 _count; // of _samples in use
+	i32 _next; // where the next accepted sample goes
+	i32 _rejections; // in a row
+	bool _powerOnPending; // an 85 C first sample awaits confirmation
+
+	/**
+	 * Returns the index into _samples of the filtered sample.
+	 */
+	i32 getFilteredIndex() const;
+};
+
+#endif // __AB2_SAMPLE_FILTER_H_INCLUDED__
@@ -0,0 +1,79 @@
+#ifndef __AB2_SAMPLE_SLOT_H_INCLUDED__
+#define __AB2_SAMPLE_SLOT_H_INCLUDED__
+
+#include <atomic>
+#include <cstdint>
+
+#include <roller/core/types.h>
+#include <roller/core/string_id.h>
+
+#include "probe_handle.h"
+
+using namespace roller;
+
+struct ProbeStats;
+
+/**
+ * Holds the latest ProbeStats of one probe behind a seqlock, so any number of
+ * readers can take a consistent copy without a lock and without ever holding
+ * up the writer.
+ *
+ * The writer bumps the sequence to odd, stores the fields and bumps it back to
+ * even. A reader retries if the sequence was odd or changed while it copied the
+ * fields. Every field is an atomic, so a torn read is only ever discarded,
+ * never undefined.
+ *
+ * Only one thread may store at a time (TemperatureManager stores under its
+ * data lock); load() is threadsafe.
+ */
+class SampleSlot {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param sensorId is the id of the probe, fixed for the life of the slot
+	 * @param handle is the handle of the probe, fixed for the life of the slot
+	 */
+	SampleSlot( const StringId& sensorId, ProbeHandle handle );
+
+	/**
+	 * Publish new stats. The id and handle are ignored.
+	 */
+	void store( const ProbeStats& stats );
+
+	/**
+	 * Returns a consistent copy of the latest stats. Never blocks; spins only
+	 * while a store is in progress.
+	 */
+	ProbeStats load() const;
+
+	/**
+	 * Returns the id of the probe.
+	 */
+	const StringId& getId() const;
+
+private:
+
+	const StringId _id;
+	const ProbeHandle _handle;
+
+	std::atomic<uint32_t> _sequence;
+
+	std::atomic<i32> _lastTemp;
+	std::atomic<i32> _rawTemp;
+	std::atomic<i64> _firstSeen;
+	std::atomic<i64> _lastSeen;
+	std::atomic<i64> _numSuccess;
+	std::atomic<i64> _numErrors;
+	std::atomic<i64> _numRejected;
+	std::atomic<i32> _pollInterval;
+	std::atomic<i32> _resolution;
+	std::atomic<bool> _active;
+	std::atomic<i32> _health; // a ProbeHealth
+	std::atomic<i32> _priority; // a ProbePriority
+	std::atomic<i32> _sampleAge;
+};
+
+#endif // __AB2_SAMPLE_SLOT_H_INCLUDED__
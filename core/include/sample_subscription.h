@@ -0,0 +1,77 @@
+#ifndef __AB_SAMPLE_SUBSCRIPTION_H
+#define __AB_SAMPLE_SUBSCRIPTION_H
+
+#include <map>
+#include <condition_variable>
+#include <mutex>
+
+#include <roller/core/string_id.h>
+#include <roller/core/indexed_container.h>
+
+#include "temperature_manager.h"
+
+using namespace roller;
+using std::map;
+
+/**
+ * SampleSubscription collects fresh samples from a TemperatureManager so that a
+ * consumer (e.g. a control loop) can block until new data arrives and run on it
+ * right away, instead of polling the latest cached temperature on a timer.
+ *
+ * A sample is fresh if the probe was read successfully and its timestamp is
+ * newer than the last sample delivered for that probe. Failed reads, stale and
+ * duplicate samples are dropped. If several samples arrive for a probe between
+ * calls to waitForSamples(), only the latest is delivered.
+ *
+ * waitForSamples() should only be called from one thread. Everything else is
+ * threadsafe.
+ */
+class SampleSubscription {
+
+public:
+
+	/**
+	 * Constructor. Subscribes to the given TemperatureManager, which must outlive
+	 * the subscription.
+	 */
+	SampleSubscription( TemperatureManager& temperatureManager );
+
+	/**
+	 * Destructor. Unsubscribes.
+	 */
+	~SampleSubscription();
+
+	/**
+	 * Wait for fresh samples. Returns as soon as there is at least one fresh
+	 * sample, or when the timeout expires, or when wake() is called.
+	 *
+	 * @param timeoutMs is the maximum time to wait, in milliseconds
+	 * @param samples is filled with the latest fresh sample of each probe that
+	 *		has one, keyed by probe id (it is cleared first)
+	 * @return true if any samples were returned
+	 */
+	bool waitForSamples( i32 timeoutMs, map<StringId, ProbeStats>& samples );
+
+	/**
+	 * Wake up a thread blocked in waitForSamples()
+	 */
+	void wake();
+
+private:
+
+	/**
+	 * ProbeStats listener
+	 */
+	void onProbeStatsChanged( const ProbeStats& before, const ProbeStats& after );
+
+	TemperatureManager& _temperatureManager;
+	Key _listenerKey;
+
+	std::mutex _lock;
+	std::condition_variable _condition;
+	map<StringId, ProbeStats> _pending;
+	map<StringId, i64> _lastDelivered;
+	bool _woken;
+};
+
+#endif // __AB_SAMPLE_SUBSCRIPTION_H
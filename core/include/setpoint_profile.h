@@ -0,0 +1,143 @@
+#ifndef __AB2_SETPOINT_PROFILE_H_INCLUDED__
+#define __AB2_SETPOINT_PROFILE_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include <roller/core/types.h>
+
+#include <json.hpp>
+
+using namespace roller;
+
+/**
+ * One step of a SetpointProfile: ramp to a target at a given rate, then hold
+ * it for a given duration.
+ */
+struct ProfileStep {
+	f32 _target = 0.0f;			// C
+	f32 _rampRate = 0.0f;		// C / minute, 0 to jump straight to target
+	f32 _soakDuration = 0.0f;	// seconds
+};
+
+/**
+ * Ramp and soak setpoint generator. Produces a smoothly moving setpoint from a
+ * list of steps. It is advanced on every control tick with update() and the
+ * result fed to the controller's setpoint.
+ *
+ * Each step ramps the setpoint linearly from where the previous one left off
+ * to the step's target. Once the setpoint has reached the target, the soak
+ * timer starts as soon as the measured temperature is within the tolerance of
+ * the target. When the last step's soak completes, the profile holds its final
+ * target.
+ */
+class SetpointProfile {
+
+public:
+
+	/**
+	 * Phase of the profile
+	 */
+	enum class Phase {
+		IDLE,
+		RAMPING,
+		WAITING,	// setpoint at target, waiting for temperature to arrive
+		SOAKING,
+		DONE
+	};
+
+	/**
+	 * Constructor. Creates an idle profile with no steps.
+	 */
+	SetpointProfile();
+
+	/**
+	 * Start the profile with the given steps.
+	 *
+	 * @param steps are the steps to run, in order
+	 * @param initialSetpoint is where the first ramp starts from
+	 */
+	void start( const std::vector<ProfileStep>& steps, f32 initialSetpoint );
+
+	/**
+	 * Stop the profile. The profile goes back to idle.
+	 */
+	void stop();
+
+	/**
+	 * Advance the profile. Returns the new setpoint.
+	 *
+	 * @param temp is the latest measured temperature (C)
+	 * @param dt is the time since the last update (s)
+	 */
+	f32 update( f32 temp, f32 dt );
+
+	/**
+	 * Returns true if the profile is running (not idle or done)
+	 */
+	bool isActive() const;
+
+	/**
+	 * Returns the Phase
+	 */
+	Phase getPhase() const;
+
+	/**
+	 * Returns the index of the current step
+	 */
+	size_t getStepIndex() const;
+
+	/**
+	 * Returns the steps
+	 */
+	const std::vector<ProfileStep>& getSteps() const;
+
+	/**
+	 * Returns the current setpoint (C)
+	 */
+	f32 getSetpoint() const;
+
+	/**
+	 * Returns the rate (C / s) the setpoint is ramping at, negative when ramping
+	 * down. Zero outside a ramp, and for steps that jump straight to target.
+	 */
+	f32 getRampRate() const;
+
+	/**
+	 * Returns the estimated time (s) remaining in the current phase. Unknown
+	 * (-1) while waiting for the temperature to arrive.
+	 */
+	f32 getPhaseRemaining() const;
+
+	/**
+	 * Sets Tolerance (C)
+	 */
+	void setTolerance( f32 tolerance );
+
+	/**
+	 * Returns Tolerance (C)
+	 */
+	f32 getTolerance() const;
+
+	/**
+	 * Parse steps from a string of comma separated steps, each of which is
+	 * colon separated "target:rampRate:soakDuration".
+	 *
+	 * e.g. "66:1:3600,76:1:600"
+	 */
+	static std::vector<ProfileStep> parse( const std::string& steps );
+
+private:
+
+	std::vector<ProfileStep> _steps;
+	Phase _phase;
+	size_t _stepIndex;
+	f32 _setpoint;
+	f32 _soakElapsed;
+	f32 _tolerance;
+};
+
+void to_json(nlohmann::json& j, const SetpointProfile::Phase& phase);
+void to_json(nlohmann::json& j, const SetpointProfile& profile);
+
+#endif // __AB2_SETPOINT_PROFILE_H_INCLUDED__
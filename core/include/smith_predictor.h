@@ -0,0 +1,115 @@
+#ifndef __AB2_SMITH_PREDICTOR_H_INCLUDED__
+#define __AB2_SMITH_PREDICTOR_H_INCLUDED__
+
+#include <deque>
+#include <memory>
+#include <utility>
+
+#include <roller/core/types.h>
+
+#include "pid.h"
+
+using namespace roller;
+
+/**
+ * Smith predictor. Wraps a PID to compensate for dead time (transport delay)
+ * between the output and the measured input.
+ *
+ * The process is modelled as first order plus dead time (FOPDT):
+ *
+ *      tau * dy/dt = K * u(t - theta) - y
+ *
+ * The predictor runs the model without the delay alongside a copy delayed by
+ * theta, and feeds the PID the measured input corrected by the difference:
+ *
+ *      feedback = input + (y_undelayed - y_delayed)
+ *
+ * so the PID sees the response to its output right away instead of after
+ * the dead time. With an accurate model this allows much more aggressive gains.
+ *
+ * The output u is taken from setAppliedOutput() when called, otherwise from the
+ * PID's own (clamped) output.
+ */
+class SmithPredictor {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param pid is the PID to wrap
+	 * @param processGain is the steady state change in input per unit of output (K)
+	 * @param timeConstant is the time constant of the process, in seconds (tau)
+	 * @param deadTime is the dead time of the process, in seconds (theta)
+	 */
+	SmithPredictor( std::shared_ptr<PID> pid, f32 processGain, f32 timeConstant, f32 deadTime );
+
+	/**
+	 * Update. Same as PID::update(), but with dead time compensation.
+	 *
+	 * @param input is the measured (delayed) input
+	 * @param dt is the change in time since this was last called, in seconds
+	 */
+	f32 update( f32 input, f32 dt );
+
+	/**
+	 * Report the output that was actually applied for the last update(). This
+	 * is forwarded to the PID and used to drive the model.
+	 */
+	void setAppliedOutput( f32 appliedOutput );
+
+	/**
+	 * Change the model. The model state is kept, so this can be called every
+	 * cycle with updated parameters.
+	 */
+	void setModel( f32 processGain, f32 timeConstant, f32 deadTime );
+
+	/**
+	 * Returns ProcessGain (K)
+	 */
+	f32 getProcessGain() const;
+
+	/**
+	 * Returns TimeConstant (tau)
+	 */
+	f32 getTimeConstant() const;
+
+	/**
+	 * Returns DeadTime (theta)
+	 */
+	f32 getDeadTime() const;
+
+	/**
+	 * Returns the correction (y_undelayed - y_delayed) applied on the last update()
+	 */
+	f32 getCorrection() const;
+
+	/**
+	 * Returns the wrapped PID
+	 */
+	std::shared_ptr<PID> getPID() const;
+
+private:
+
+	/**
+	 * Returns the model output as it was deadTime seconds ago
+	 */
+	f32 getDelayedModelOutput() const;
+
+	std::shared_ptr<PID> _pid;
+
+	// model
+	f32 _processGain;
+	f32 _timeConstant;
+	f32 _deadTime;
+
+	// state
+	f32 _appliedOutput;
+	bool _hasAppliedOutput;
+	f32 _clock;
+	f32 _modelOutput;
+	f32 _correction;
+	std::deque<std::pair<f32, f32>> _history; // (time, model output)
+};
+
+#endif // __AB2_SMITH_PREDICTOR_H_INCLUDED__
@@ -0,0 +1,104 @@
+#ifndef __AB2_TEMPERATURE_ESTIMATOR_H_INCLUDED__
+#define __AB2_TEMPERATURE_ESTIMATOR_H_INCLUDED__
+
+#include <roller/core/types.h>
+
+using namespace roller;
+
+/**
+ * A temperature estimate at a given instant.
+ */
+struct TemperatureEstimate {
+	f32 _temp = 0.0f; // C
+	f32 _slope = 0.0f; // C / s
+	f32 _stdDev = 0.0f; // C, of _temp
+	i64 _time = 0; // ms, the instant the estimate is for
+	i64 _sampleTime = 0; // ms, the last sample the estimate is based on
+};
+
+/**
+ * Kalman filter tracking a probe's temperature and its slope (constant slope
+ * model), so the temperature can be predicted at any instant between samples,
+ * with its uncertainty.
+ *
+ * The measurement noise is the standard deviation of a single sample. The
+ * process noise is the spectral density of changes in slope (C^2 / s^3): the
+ * larger it is, the faster the estimate follows a change in heating rate, and
+ * the faster the uncertainty of a prediction grows with its distance from the
+ * last sample.
+ *
+ * Not threadsafe.
+ */
+class TemperatureEstimator {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param measurementNoise is the standard deviation of a sample (C)
+	 * @param processNoise is the spectral density of slope changes (C^2 / s^3)
+	 */
+	TemperatureEstimator( f32 measurementNoise = 0.03f, f32 processNoise = 1.0e-5f );
+
+	/**
+	 * Forget all samples.
+	 */
+	void reset();
+
+	/**
+	 * Returns true once there has been at least one sample.
+	 */
+	bool isInitialized() const;
+
+	/**
+	 * Add a sample. Samples older than the last one are ignored.
+	 *
+	 * @param temp is the measured temperature (C)
+	 * @param time is the time of the sample (ms)
+	 */
+	void update( f32 temp, i64 time );
+
+	/**
+	 * Predict the temperature at the given time (ms). Times before the last
+	 * sample return the estimate at the last sample.
+	 */
+	TemperatureEstimate predict( i64 time ) const;
+
+	/**
+	 * Sets MeasurementNoise (C)
+	 */
+	void setMeasurementNoise( f32 measurementNoise );
+
+	/**
+	 * Returns MeasurementNoise (C)
+	 */
+	f32 getMeasurementNoise() const;
+
+	/**
+	 * Sets ProcessNoise (C^2 / s^3)
+	 */
+	void setProcessNoise( f32 processNoise );
+
+	/**
+	 * Returns ProcessNoise (C^2 / s^3)
+	 */
+	f32 getProcessNoise() const;
+
+private:
+
+	/**
+	 * Propagate a state and covariance forward by dt (s)
+	 */
+	void propagate( f64 dt, f64 x[2], f64 p[2][2] ) const;
+
+	f32 _measurementNoise;
+	f32 _processNoise;
+
+	bool _initialized;
+	i64 _time;
+	f64 _x[2]; // temp, slope
+	f64 _p[2][2];
+};
+
+#endif // __AB2_TEMPERATURE_ESTIMATOR_H_INCLUDED__
@@ -1,14 +1,26 @@
 #ifndef __AB_TEMPERATURE_MANAGER_H
 #define __AB_TEMPERATURE_MANAGER_H
 
+#include <atomic>
 #include <map>
 #include <list>
 #include <utility>
 #include <memory>
 #include <set>
+#include <string>
+#include <vector>
 #include <functional>
+#include <mutex>
+#include <condition_variable>
 
 #include "hw_manager.h"
+#include "bounded_queue.h"
+#include "bulk_temperature_reader.h"
+#include "probe_bus.h"
+#include "probe_handle.h"
+#include "sample_filter.h"
+#include "sample_slot.h"
+#include "temperature_estimator.h"
 
 #include <roller/core/string_id.h>
 #include <roller/core/thread.h>
@@ -21,8 +33,11 @@ using std::map;
 using std::list;
 using std::pair;
 using std::unique_ptr;
+using std::shared_ptr;
 using std::function;
 using std::set;
+using std::string;
+using std::vector;
 
 #define ABS_ZERO_CELCIUS -273.15
 
@@ -40,28 +55,151 @@ struct ProbeSettings {
 	bool _showInGraphs;
 };
 
+/**
+ * How far a probe's reads can be trusted to work.
+ *
+ * A failed read makes a healthy probe SUSPECT. A few failures in a row
+ * QUARANTINE it: it is then only read after a backoff that doubles with every
+ * further failure, so a broken probe stops costing the others sweep time. A
+ * successful read lets it back to SUSPECT, at its normal rate, and another makes
+ * it HEALTHY again.
+ */
+enum class ProbeHealth {
+	HEALTHY,
+	SUSPECT,
+	QUARANTINED
+};
+
+/**
+ * The order in which probes are read within a sweep: the probes control loops
+ * depend on first, so their samples are as close to the tick as can be.
+ */
+enum class ProbePriority {
+	CRITICAL, // a control loop depends on it (see TemperatureManager::setDemandedProbes())
+	SUBSCRIBED, // a stats listener subscribed to it by id
+	NORMAL
+};
+
 /**
  * ProbeStats struct
  */
 struct ProbeStats {
 	StringId _id;
-	i32 _lastTemp;
+	ProbeHandle _handle;
+	i32 _lastTemp; // mC, filtered
+	i32 _rawTemp; // mC, the last sample read, rejected or not
 	i64 _firstSeen;
-	i64 _lastSeen;
+	i64 _lastSeen; // ms, of the sample _lastTemp came from
 	i64 _numSuccess;
 	i64 _numErrors;
+	i64 _numRejected; // samples read but not believed (see SampleFilter)
+	i32 _pollInterval; // ms, the current interval between reads
+	i32 _resolution; // bits, the current requested resolution (0 if the probe's reader can't change it)
+	bool _active; // true while polled at the active rate
+	ProbeHealth _health;
+	ProbePriority _priority;
+	i32 _sampleAge; // ms, from the sweep being requested (or a background read starting) until its sample was taken
+};
+
+/**
+ * How a virtual probe combines its sources.
+ */
+enum class FusionMode {
+	WEIGHTED_MEAN, // by VirtualProbeSettings::_weights
+	INVERSE_VARIANCE, // by 1 / variance of each source's TemperatureEstimator
+	MIN,
+	MAX
+};
+
+/**
+ * A virtual probe: one temperature fused from several physical probes (e.g. a tun
+ * probe and a return probe, or the top and bottom of a stratified kettle).
+ *
+ * Only sources read successfully within _maxAge count, and the weights of the ones
+ * that do are renormalized, so losing a source shifts the value to the others
+ * rather than losing it. The probe only fails (counts an error) when every source
+ * is stale.
+ */
+struct VirtualProbeSettings {
+	FusionMode _mode = FusionMode::WEIGHTED_MEAN;
+	vector<StringId> _sources;
+	vector<f32> _weights; // WEIGHTED_MEAN only, one per source (missing weights are 1)
+	i32 _maxAge = 10000; // ms
+};
+
+/**
+ * How often, and at which resolution, to read a probe.
+ *
+ * A probe is active while a control loop depends on it (see
+ * TemperatureManager::setDemandedProbes()), while its temperature moves faster
+ * than _stableSlope, or during its first few samples. Active probes are read every
+ * _activeInterval, the rest every _idleInterval.
+ *
+ * Resolutions only apply to probes read through a BulkTemperatureReader that
+ * supports them. A DS18B20 converts in 94 ms at 9 bit (0.5 C), 188 ms at 10 bit
+ * (0.25 C), 375 ms at 11 bit (0.125 C) and 750 ms at 12 bit (0.0625 C).
+ */
+struct ProbePollPolicy {
+	i32 _activeInterval = 333; // ms
+	i32 _idleInterval = 5000; // ms
+	i32 _activeResolution = 10; // bits
+	i32 _idleResolution = 12; // bits
+	f32 _stableSlope = 0.02f; // C / s
+};
+
+/**
+ * What happens to stats events when the listeners fall behind.
+ */
+enum class EventOverflowPolicy {
+	DROP_OLDEST, // every change is queued; when the queue is full the oldest is dropped
+	COALESCE // one pending event per probe; later changes update its "after" stats
+};
+
+/**
+ * Stats of the stats event queue.
+ */
+struct EventQueueStats {
+	i32 _capacity;
+	i64 _depth; // events waiting
+	i64 _maxDepth;
+	i64 _posted;
+	i64 _delivered;
+	i64 _dropped;
+	i64 _coalesced; // changes merged into a pending event
+	i64 _filtered; // deliveries held back by a subscription's _minChange or _minInterval
+};
+
+/**
+ * Which stats changes a listener wants.
+ *
+ * A change of a subscribed probe is delivered if, compared with the stats last
+ * delivered to the listener for that probe, the temperature moved by at least
+ * _minChange or (with _errors) the error count changed, and at least _minInterval
+ * has passed since that delivery. The first stats of a probe always pass. The
+ * default subscription passes every change of every probe.
+ */
+struct StatsSubscription {
+	set<StringId> _probes; // empty for every probe
+	i32 _minChange = 0; // in the units of ProbeStats::_lastTemp
+	bool _errors = true; // an error count change passes whatever the temperature did
+	i32 _minInterval = 0; // ms, per probe
 };
 
 typedef function<void(const ProbeStats& before, const ProbeStats& after)> ProbeStatsListener;
 typedef function<void(const ProbeSettings& settings, const ProbeStats& stats)> NewProbeListener;
+typedef function<void(const ProbeSettings& settings, const ProbeStats& stats)> RemovedProbeListener;
+typedef function<void(const ProbeStats& stats, ProbeHealth before)> ProbeHealthListener;
 
 /**
  * TemperatureManager manages temperatures. It will poll temperatures in a separate thread. The
- * latest temperature can always be obtained. Obtaining a temperature from the manager requires a
- * mutex lock and unlock.
+ * latest temperature can always be obtained, without taking a lock (see getProbeStats()).
  *
  * TemperatureManager is a thread. To start it, simply call start (Thread::start() ).
  *
+ * The probes of each devman temperature sensor manager (each 1-Wire bus) are read by their
+ * own ProbeBus, so a failing probe on one bus never delays the probes of another. Stats
+ * events are delivered on a dispatch thread, and probes are discovered on another.
+ *
  * TemperatureManager uses devman to obtain temperature readings. The user should configure 
  * devman with the proper device managers before starting TemperatureManager.
  */
@@ -80,12 +218,13 @@ public:
 	~TemperatureManager();
 
 	/**
-	 * Stop the thread
+	 * Stop the thread. Wakes it immediately if it is waiting for the next sweep.
+	 * If the thread hasn't started yet, it returns as soon as it does.
 	 */
 	void stop();
 
 	/**
-	 * Sets UpdateFrequency
+	 * Sets UpdateFrequency, the shortest time (ms) between two sweeps
 	 *
 	 * @param updateFrequency is the new value for UpdateFrequency
 	 */
@@ -104,12 +243,153 @@ public:
 	list<StringId> listProbes();
 
 	/**
-	 * Get the probe stats for the given probe
+	 * Returns the known probes, without taking the data lock. The list is an
+	 * immutable snapshot, valid for as long as it is held; call again to see
+	 * probes found since.
+	 */
+	shared_ptr<const vector<StringId>> getProbes() const;
+
+	/**
+	 * Get the probe stats for the given probe, without locking. The copy is
+	 * always consistent (all fields from the same update).
 	 *
 	 * @param sensorId is the id of the sensor
 	 * @return the ProbeStats for the given probe
 	 */
-	const ProbeStats& getProbeStats( const StringId& sensorId ) const;
+	ProbeStats getProbeStats( const StringId& sensorId ) const;
+
+	/**
+	 * Get the probe stats for the given probe by handle, without locking.
+	 */
+	ProbeStats getProbeStats( ProbeHandle handle ) const;
+
+	/**
+	 * Returns the handle of the given probe, without locking. Throws if the
+	 * probe is unknown. A handle is the probe's index in a dense array, resolved
+	 * once when it is discovered, and stays the probe's if it goes and comes back.
+	 */
+	ProbeHandle getProbeHandle( const StringId& sensorId ) const;
+
+	/**
+	 * Get the estimated temperature of the given probe at the given time,
+	 * extrapolated from its filtered samples. Throws if the probe has no samples yet.
+	 *
+	 * @param sensorId is the id of the sensor
+	 * @param time is the time (ms) to estimate for, e.g. getTime()
+	 * @return the estimate
+	 */
+	TemperatureEstimate getEstimate( const StringId& sensorId, i64 time ) const;
+
+	/**
+	 * Get the estimated temperature of the given probe, by handle, at the given time.
+	 */
+	TemperatureEstimate getEstimate( ProbeHandle handle, i64 time ) const;
+
+	/**
+	 * Read all probes of the given devman temperature sensor manager with the
+	 * given BulkTemperatureReader. Pass nullptr to go back to reading them one
+	 * at a time. This is threadsafe.
+	 */
+	void setBulkReader( const StringId& managerId, const shared_ptr<BulkTemperatureReader>& reader );
+
+	/**
+	 * Sets the ProbePollPolicy of probes that have none of their own. This is
+	 * threadsafe.
+	 */
+	void setDefaultPollPolicy( const ProbePollPolicy& policy );
+
+	/**
+	 * Sets the ProbePollPolicy of the given probe. This is threadsafe.
+	 */
+	void setPollPolicy( const StringId& sensorId, const ProbePollPolicy& policy );
+
+	/**
+	 * Go back to the default ProbePollPolicy for the given probe. This is threadsafe.
+	 */
+	void clearPollPolicy( const StringId& sensorId );
+
+	/**
+	 * Returns the ProbePollPolicy of the given probe, or the default if it has
+	 * none of its own. This is threadsafe.
+	 */
+	ProbePollPolicy getPollPolicy( const StringId& sensorId ) const;
+
+	/**
+	 * Sets the probes control loops currently depend on; they are read at the
+	 * active rate of their ProbePollPolicy. This is threadsafe.
+	 */
+	void setDemandedProbes( const set<StringId>& sensorIds );
+
+	/**
+	 * Add or change a virtual probe. It gets a handle, stats and stats events like
+	 * any probe, recomputed on every sample of its sources, and is listed by
+	 * getProbes(). Demanding it (see setDemandedProbes()) demands its sources.
+	 * Throws a RollerException if the id is a physical probe's or there are no
+	 * sources. This is threadsafe.
+	 */
+	void setVirtualProbe( const StringId& sensorId, const VirtualProbeSettings& settings );
+
+	/**
+	 * Remove a virtual probe. Its handle stays valid, as for a physical probe that
+	 * has gone. This is threadsafe.
+	 */
+	void removeVirtualProbe( const StringId& sensorId );
+
+	/**
+	 * Returns the settings of each virtual probe, keyed by id. This is threadsafe.
+	 */
+	map<StringId, VirtualProbeSettings> getVirtualProbes() const;
+
+	/**
+	 * Sets the timeout (ms) of each probe read (or bulk read) on every bus; a
+	 * read that times out costs its bus at most that much per sweep (see
+	 * ProbeBus). This is threadsafe.
+	 */
+	void setReadTimeout( i32 readTimeout );
+
+	/**
+	 * Returns the sweep metrics of each bus, keyed by manager id. This is threadsafe.
+	 */
+	map<StringId, BusStats> getBusStats() const;
+
+	/**
+	 * Sets the limits samples are checked against before they are accepted, for
+	 * every probe. Each sample goes through the probe's SampleFilter: rejected
+	 * samples are counted in _numRejected (not _numErrors), and _lastTemp is the
+	 * median of the last 3 accepted ones. This is threadsafe.
+	 */
+	void setSampleFilterSettings( const SampleFilterSettings& settings );
+
+	/**
+	 * Returns the SampleFilterSettings.
+	 */
+	SampleFilterSettings getSampleFilterSettings();
+
+	/**
+	 * Sets the EventOverflowPolicy (DROP_OLDEST by default). Stats events go
+	 * through a bounded lock-free queue to the dispatch thread, so a slow
+	 * listener never holds up a sweep; this decides what gives when the
+	 * listeners fall far enough behind to fill it. This is threadsafe.
+	 */
+	void setEventOverflowPolicy( EventOverflowPolicy policy );
+
+	/**
+	 * Returns the EventOverflowPolicy.
+	 */
+	EventOverflowPolicy getEventOverflowPolicy() const;
+
+	/**
+	 * Returns the stats of the stats event queue. This is threadsafe.
+	 */
+	EventQueueStats getEventQueueStats() const;
+
+	/**
+	 * Sets the file the probe inventory is saved to whenever it changes, and
+	 * loaded from on start, so after a restart the last known probes are read
+	 * right away instead of after discovery. Empty (the default) disables it.
+	 * Call before starting the thread.
+	 */
+	void setInventoryPath( const string& path );
 
 	/**
 	 * Returns the sample rate (the rate at which the stored buffers are filled)
@@ -117,12 +397,21 @@ public:
 	i32 getSampleRate();
 
 	/**
-	 * Add a ProbeStats listener. This is threadsafe.
+	 * Add a ProbeStats listener for every change of every probe. This is threadsafe.
 	 */
 	Key addStatsListener( const ProbeStatsListener& listener );
 
 	/**
-	 * Remove a ProbeStats listener. This is threadsafe.
+	 * Add a ProbeStats listener for the changes that pass the given subscription.
+	 * Filtering happens on the dispatch thread, before the listener is called; the
+	 * "before" stats it gets are the ones last delivered to it for that probe. This
+	 * is threadsafe.
+	 */
+	Key addStatsListener( const ProbeStatsListener& listener, const StatsSubscription& subscription );
+
+	/**
+	 * Remove a ProbeStats listener. This is threadsafe. An event already being
+	 * delivered may still reach the listener after this returns.
 	 */
 	void removeStatsListener( const Key& key );
 
@@ -136,22 +425,238 @@ public:
 	 */
 	void removeNewProbeListener( const Key& key );
 
+	/**
+	 * Add a removed probe listener. A probe is only removed after it has been
+	 * missing from two discoveries in a row. This is threadsafe.
+	 */
+	Key addRemovedProbeListener( const RemovedProbeListener& listener );
+
+	/**
+	 * Remove a removed probe listener. This is threadsafe.
+	 */
+	void removeRemovedProbeListener( const Key& key );
+
+	/**
+	 * Add a probe health listener, called on the dispatch thread when a probe's
+	 * ProbeHealth changes. This is threadsafe.
+	 */
+	Key addHealthListener( const ProbeHealthListener& listener );
+
+	/**
+	 * Remove a probe health listener. This is threadsafe.
+	 */
+	void removeHealthListener( const Key& key );
+
 private:
 
+	/**
+	 * An immutable snapshot of the probe set.
+	 */
+	struct ProbeTable {
+		vector<StringId> _sensorIds;
+		map<StringId, ProbeHandle> _handles;
+		vector<const SampleSlot*> _slots; // by handle
+	};
+
+	/**
+	 * A stats listener, its subscription and what it was last given.
+	 */
+	struct StatsSubscriber {
+		ProbeStatsListener _listener;
+		StatsSubscription _subscription;
+		map<StringId, ProbeStats> _delivered; // per probe
+		map<StringId, i64> _deliveredAt; // per probe
+	};
+
+	/**
+	 * A probe's pending stats event, when coalescing.
+	 */
+	struct ProbeMailbox {
+		std::mutex _lock;
+		bool _queued = false;
+		ProbeStats _before;
+		ProbeStats _after;
+	};
+
+	/**
+	 * A queued stats event: either the stats themselves or, when coalescing,
+	 * the probe's mailbox.
+	 */
+	struct StatsEvent {
+		ProbeStats _before;
+		ProbeStats _after;
+		ProbeMailbox* _mailbox = nullptr;
+	};
+
+	/**
+	 * Everything about one probe, resolved when it is discovered.
+	 */
+	struct ProbeEntry {
+		ProbeSettings _settings;
+		ProbeStats _stats; // the writers' copy, published to _slot
+		unique_ptr<SampleSlot> _slot;
+		unique_ptr<ProbeMailbox> _mailbox;
+		SampleFilter _filter;
+		TemperatureEstimator _estimator;
+		shared_ptr<TemperatureSensor> _sensor;
+		shared_ptr<BulkTemperatureReader> _bulkReader; // of its manager, if any
+		size_t _bus; // index in _buses
+		ProbePollPolicy _pollPolicy; // its own, or the default
+		bool _demanded;
+		i64 _nextRead; // ms
+		bool _present; // false once discovery has lost it (or a virtual probe is removed)
+		i32 _missedDiscoveries; // in a row
+		i32 _failedReads; // in a row
+		i32 _backoff; // ms between reads while quarantined, 0 until quarantined
+		bool _virtual; // fused from other probes, never read
+		VirtualProbeSettings _fusion; // virtual probes only
+		vector<ProbeHandle> _sources; // virtual probes only, per _fusion._sources (invalid if unknown)
+		i64 _lastFusionError; // ms, virtual probes only, when it last counted having no fresh sources
+		vector<ProbeHandle> _fusedInto; // the virtual probes this one is a source of
+	};
+
+	/**
+	 * Collect the probes stats listeners subscribed to by id, for their
+	 * ProbePriority.
+	 */
+	void updateSubscribedProbes();
+
+	/**
+	 * Move a probe's ProbeHealth on after a read. Call with the data lock held.
+	 */
+	void updateHealth( ProbeEntry& entry, bool success );
+
+	/**
+	 * Rebuild the links between virtual probes and their sources. Call with the
+	 * data lock held whenever probes or virtual probes are added or changed.
+	 */
+	void linkVirtualProbes();
+
+	/**
+	 * Work out which probes are demanded, and the ProbePriority of each, directly
+	 * or through a virtual probe.
+	 * Call with the data lock held.
+	 */
+	void updateDemand();
+
+	/**
+	 * Recompute a virtual probe after a reading of one of its sources. Call with
+	 * the data lock held. Returns true if its stats changed.
+	 *
+	 * With no fresh sources an error is counted if the reading was a new
+	 * sample, or if a poll interval has passed since the last such error.
+	 *
+	 * @param accepted is true if the reading was a new sample
+	 */
+	bool fuseProbe( ProbeEntry& entry, bool accepted );
+
 	/**
 	 * Run the thread.
 	 */
 	void doRun();
 
 	/**
-	 * Update probe list.
+	 * Run the dispatch thread: deliver queued stats events until stopped and
+	 * drained.
+	 */
+	void doDispatch();
+
+	/**
+	 * Queue a stats event for the dispatch thread. Never blocks.
+	 */
+	void postStatsEvent( ProbeMailbox* mailbox, const ProbeStats& before, const ProbeStats& after );
+
+	/**
+	 * Account for an event dropped from the queue.
+	 */
+	void discardStatsEvent( const StatsEvent& event );
+
+	/**
+	 * Run the discovery thread: list the probes every _updateProbeListFrequency.
+	 */
+	void doDiscovery();
+
+	/**
+	 * Update probe list. Adds new probes, removes lost ones and fires the
+	 * events.
 	 */
 	void updateProbeList();
 
 	/**
-	 * Update temperatures.
+	 * Add a probe entry. Call with _dataLock held.
+	 *
+	 * @return the handle of the new probe
+	 */
+	ProbeHandle addProbe( const StringId& managerId, const StringId& sensorId, i64 now );
+
+	/**
+	 * Resolve a probe's devman sensor. Returns false (and logs) if it failed.
+	 * Call with _dataLock held.
 	 */
-	void updateTemperatures();
+	bool resolveSensor( ProbeEntry& entry );
+
+	/**
+	 * Add the probes in the inventory file, firing the new probe events.
+	 * Probes whose sensor can't be resolved are left to discovery.
+	 */
+	void loadInventory();
+
+	/**
+	 * Save the present probes to the inventory file.
+	 */
+	void saveInventory();
+
+	/**
+	 * Create a ProbeBus for any manager that has none and hand each bus its probes.
+	 * Call with _dataLock held.
+	 */
+	void updateBuses();
+
+	/**
+	 * Returns when (ms) the next probe is due. Call without _scheduleLock held.
+	 */
+	i64 getNextDeadline();
+
+	/**
+	 * Update temperatures. Asks each bus to read its probes that are due; does
+	 * not wait for the reads.
+	 */
+	void updateTemperatures( i64 now );
+
+	/**
+	 * Work out whether a probe is active and apply its interval and resolution
+	 * to its stats and reader. Call with _dataLock held.
+	 */
+	void scheduleProbe( ProbeEntry& entry, i64 now );
+
+	/**
+	 * Returns the handle of the given probe, or AB_INVALID_PROBE_HANDLE. Call
+	 * with _dataLock held.
+	 */
+	ProbeHandle findProbe( const StringId& sensorId ) const;
+
+	/**
+	 * Wake the loop to plan again, e.g. after a policy change
+	 */
+	void reschedule();
+
+	/**
+	 * Record the result of reading a probe and fire the stats changed event.
+	 *
+	 * @param handle is the handle of the probe
+	 * @param success is true if the read succeeded
+	 * @param temp is the temperature read (milli C), if successful
+	 * @param time is the time of the reading (ms), if successful
+	 * @param issued is when the bus issued the read (ms), see ProbeBus::ReadingCallback
+	 * @param error describes the failure, if not successful
+	 */
+	void recordReading( ProbeHandle handle, bool success, i32 temp, i64 time, i64 issued, const string& error );
+
+	/**
+	 * Publish a new ProbeTable of the known probes. Call with _dataLock held.
+	 */
+	void publishProbeTable();
+
 
 	/**
 	 * Dump temp data. This is a crude hack to make temp data available outside the
@@ -176,21 +681,76 @@ private:
 	 */
 	void fireProbeAddedEvent( const ProbeSettings& settings, const ProbeStats& stats );
 
+	/**
+	 * Helper to fire probe removed events
+	 */
+	void fireProbeRemovedEvent( const ProbeSettings& settings, const ProbeStats& stats );
+
+	/**
+	 * Helper to fire probe health events
+	 */
+	void fireProbeHealthChangedEvent( const ProbeStats& stats, ProbeHealth before );
+
 	mutable Mutex _dataLock;
-	bool _running;
-	set<pair<StringId, StringId>> _knownProbes;
-	map<StringId, ProbeStats> _probeStats;
+
+	// the update loop sleeps on this until the next sweep is due, or stop()
+	std::mutex _scheduleLock;
+	std::condition_variable _scheduleCondition;
+	bool _stopping; // set by stop() only, so a stop before the thread starts sticks
+	bool _rescheduled;
+	vector<ProbeEntry> _probes; // by handle
+	map<StringId, ProbeHandle> _probeHandles;
+
+	// only accessed through std::atomic_load() / std::atomic_store(), so a
+	// reader holds on to the snapshot it loaded and the writer never waits
+	shared_ptr<const ProbeTable> _probeTable;
+	map<StringId, shared_ptr<BulkTemperatureReader>> _bulkReaders;
+	vector<unique_ptr<ProbeBus>> _buses;
+	map<StringId, size_t> _busIndices; // by manager id
+	i32 _readTimeout;
+	ProbePollPolicy _defaultPollPolicy;
+	SampleFilterSettings _sampleFilterSettings;
+	map<StringId, ProbePollPolicy> _pollPolicies; // probes with their own policy
+	set<StringId> _demandedProbes;
+	set<StringId> _subscribedProbes;
 
 	i32 _updateFrequency;
 	i64 _lastUpdate;
 
 	i32 _updateProbeListFrequency;
-	i64 _lastUpdateProbeList;
+	Thread _discoveryThread;
+	std::condition_variable _discoveryCondition; // with _scheduleLock
+	string _inventoryPath;
+
+	// stats events, delivered to the listeners by the dispatch thread
+	BoundedQueue<StatsEvent> _events;
+	std::atomic<EventOverflowPolicy> _overflowPolicy;
+	std::atomic<i64> _eventDepth;
+	std::atomic<i64> _maxEventDepth;
+	std::atomic<i64> _postedEvents;
+	std::atomic<i64> _deliveredEvents;
+	std::atomic<i64> _droppedEvents;
+	std::atomic<i64> _coalescedEvents;
+	std::atomic<i64> _filteredEvents;
+	std::atomic_bool _dispatcherIdle;
+	std::mutex _dispatchLock;
+	std::condition_variable _dispatchCondition;
+	std::atomic_bool _dispatching;
+	Thread _dispatchThread;
 
 	Mutex _eventLock;
-	IndexedContainer<ProbeStatsListener> _probeStatsListeners;
+	IndexedContainer<shared_ptr<StatsSubscriber>> _probeStatsListeners;
 	IndexedContainer<NewProbeListener> _newProbeListeners;
+	IndexedContainer<RemovedProbeListener> _removedProbeListeners;
+	IndexedContainer<ProbeHealthListener> _healthListeners;
 	
 };
 
+void to_json(nlohmann::json& j, const EventQueueStats& stats);
+
+/**
+ * Returns a name for a ProbeHealth.
+ */
+const char* getProbeHealthName( ProbeHealth health );
+
 #endif // __AB_TEMPERATURE_MANAGER_H
@@ -0,0 +1,144 @@
+#ifndef __AB2_THERMAL_MODEL_H_INCLUDED__
+#define __AB2_THERMAL_MODEL_H_INCLUDED__
+
+#include <roller/core/types.h>
+
+#include <json.hpp>
+
+using namespace roller;
+
+#define AB_WATER_SPECIFIC_HEAT 4186.0f // J / (kg * C)
+#define AB_THERMAL_MODEL_MIN_LOSS 0.1f // W / C, keeps gain and time constant finite
+
+/**
+ * Lumped thermal model of a vessel heated by a single element:
+ *
+ *      C * dT/dt = P - L * (T - Tambient)
+ *
+ * where C is the heat capacity of the liquid (mass * specific heat of water),
+ * P is the power delivered by the element and L is the ambient loss coefficient.
+ *
+ * The model is used to compute a feed-forward element load: the load needed to
+ * hold a temperature against ambient losses, plus the load needed to move the
+ * temperature at a given rate. Loads are expressed as a fraction of full element
+ * power (0-1), the same as PWM loads.
+ */
+class ThermalModel {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param liquidMass is the mass of liquid in the vessel, in kg
+	 * @param elementWatts is the power of the element at full load, in W
+	 * @param lossCoefficient is the ambient loss coefficient, in W / C
+	 * @param ambientTemp is the ambient temperature, in C
+	 */
+	ThermalModel( f32 liquidMass, f32 elementWatts, f32 lossCoefficient, f32 ambientTemp );
+
+	/**
+	 * Returns the heat capacity of the vessel's contents, in J / C
+	 */
+	f32 getHeatCapacity() const;
+
+	/**
+	 * Returns the load (0-1) required to hold the given temperature against
+	 * ambient losses. May exceed 1 if the element cannot hold the temperature.
+	 */
+	f32 getSteadyStateLoad( f32 temp ) const;
+
+	/**
+	 * Returns the load required to change the temperature at the given rate
+	 * (in C / s), not counting losses. Negative for negative rates.
+	 */
+	f32 getRampLoad( f32 rate ) const;
+
+	/**
+	 * Returns the feed-forward load (clamped to 0-1) for holding the given
+	 * setpoint while it moves at the given rate (in C / s).
+	 */
+	f32 getFeedForwardLoad( f32 setpoint, f32 setpointRate ) const;
+
+	/**
+	 * Returns the steady state temperature rise above ambient per unit of load
+	 * (C at full load). This is the process gain of the first order response.
+	 */
+	f32 getProcessGain() const;
+
+	/**
+	 * Returns the time constant (s) of the first order response to a change in load.
+	 */
+	f32 getTimeConstant() const;
+
+	/**
+	 * Returns the time (s) the model takes to go from one temperature to another
+	 * at a constant load (0-1), following the first order response. Returns 0 if
+	 * already there, or a negative value if the target is never reached at that
+	 * load (e.g. beyond the steady state temperature).
+	 */
+	f32 getTimeToTemp( f32 fromTemp, f32 toTemp, f32 load ) const;
+
+	/**
+	 * Returns the temperature after holding a constant load (0-1) for the given
+	 * duration (s), starting at the given temperature.
+	 */
+	f32 getTempAfter( f32 fromTemp, f32 load, f32 duration ) const;
+
+	/**
+	 * Returns the constant load that moves the temperature from one value to
+	 * another in exactly the given duration (s). Not clamped to 0-1.
+	 */
+	f32 getLoadToReach( f32 fromTemp, f32 toTemp, f32 duration ) const;
+
+	/**
+	 * Sets LiquidMass (kg)
+	 */
+	void setLiquidMass( f32 liquidMass );
+
+	/**
+	 * Returns LiquidMass (kg)
+	 */
+	f32 getLiquidMass() const;
+
+	/**
+	 * Sets ElementWatts
+	 */
+	void setElementWatts( f32 elementWatts );
+
+	/**
+	 * Returns ElementWatts
+	 */
+	f32 getElementWatts() const;
+
+	/**
+	 * Sets LossCoefficient (W / C)
+	 */
+	void setLossCoefficient( f32 lossCoefficient );
+
+	/**
+	 * Returns LossCoefficient (W / C)
+	 */
+	f32 getLossCoefficient() const;
+
+	/**
+	 * Sets AmbientTemp (C)
+	 */
+	void setAmbientTemp( f32 ambientTemp );
+
+	/**
+	 * Returns AmbientTemp (C)
+	 */
+	f32 getAmbientTemp() const;
+
+private:
+
+	f32 _liquidMass;
+	f32 _elementWatts;
+	f32 _lossCoefficient;
+	f32 _ambientTemp;
+};
+
+void to_json(nlohmann::json& j, const ThermalModel& model);
+
+#endif // __AB2_THERMAL_MODEL_H_INCLUDED__
@@ -0,0 +1,107 @@
+#ifndef __AB2_THERMAL_MODEL_ESTIMATOR_H_INCLUDED__
+#define __AB2_THERMAL_MODEL_ESTIMATOR_H_INCLUDED__
+
+#include <roller/core/types.h>
+
+#include <json.hpp>
+
+#include "thermal_model.h"
+
+using namespace roller;
+
+/**
+ * Online identification of a vessel's ThermalModel by recursive least squares.
+ *
+ * The model C * dT/dt = P - L * (T - Tambient) is rewritten as
+ *
+ *      dT/dt = a * P + b * (T - Tambient),  a = 1 / C,  b = -L / C
+ *
+ * and (a, b) are estimated with exponential forgetting, so the estimate tracks
+ * changes like a vessel being filled or drained. Samples are averaged over a
+ * window (default 30 s) before each RLS update, since the temperature change
+ * between two probe reads is mostly quantization noise.
+ *
+ * The estimator starts from a prior model and only reports itself converged
+ * once it has run enough updates and the estimate is physically plausible.
+ */
+class ThermalModelEstimator {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param prior is the initial model; its ambient temperature is used as is
+	 * @param forgettingFactor is the RLS forgetting factor (0-1, 1 never forgets)
+	 * @param window is the averaging window (s) for each RLS update
+	 */
+	ThermalModelEstimator( const ThermalModel& prior, f32 forgettingFactor = 0.995f, f32 window = 30.0f );
+
+	/**
+	 * Start over from the given prior.
+	 */
+	void reset( const ThermalModel& prior );
+
+	/**
+	 * Add a sample.
+	 *
+	 * @param temp is the measured temperature (C)
+	 * @param power is the element power (W) applied over the dt preceding this sample
+	 * @param dt is the time since the last sample (s)
+	 */
+	void addSample( f32 temp, f32 power, f32 dt );
+
+	/**
+	 * Returns true once the estimate can be trusted.
+	 */
+	bool isConverged() const;
+
+	/**
+	 * Returns the estimated heat capacity (J / C)
+	 */
+	f32 getHeatCapacity() const;
+
+	/**
+	 * Returns the estimated loss coefficient (W / C)
+	 */
+	f32 getLossCoefficient() const;
+
+	/**
+	 * Returns the number of RLS updates run
+	 */
+	i32 getNumUpdates() const;
+
+	/**
+	 * Returns a copy of the given model with its liquid mass (from heat capacity)
+	 * and loss coefficient replaced by the estimate.
+	 */
+	ThermalModel apply( const ThermalModel& model ) const;
+
+private:
+
+	/**
+	 * Run one RLS update with the given regressors and observation
+	 */
+	void update( f64 power, f64 excessTemp, f64 rate );
+
+	f64 _forgettingFactor;
+	f64 _window;
+	f64 _ambientTemp;
+
+	// estimate and covariance
+	f64 _a;
+	f64 _b;
+	f64 _p[2][2];
+	i32 _numUpdates;
+
+	// current window
+	bool _started;
+	f64 _windowStartTemp;
+	f64 _windowElapsed;
+	f64 _windowEnergy;
+	f64 _windowTempIntegral;
+};
+
+void to_json(nlohmann::json& j, const ThermalModelEstimator& estimator);
+
+#endif // __AB2_THERMAL_MODEL_ESTIMATOR_H_INCLUDED__
@@ -1,10 +1,13 @@
 #include "current_limiter.h"
 
+#include <algorithm>
+
 using json = nlohmann::json;
 
 CurrentLimiter::CurrentLimiter(uint32_t baseMilliAmps, uint32_t maxMilliAmps)
 		: _baseMilliAmps(baseMilliAmps)
 		, _maxMilliAmps(maxMilliAmps)
+		, _listenerLock(true)
 {
 }
 
@@ -79,7 +82,7 @@ CurrentLimiter::PinConfiguration CurrentLimiter::getPinConfiguration(uint32_t pi
 }
 
 // getPinState
-const CurrentLimiter::PinState& CurrentLimiter::getPinState(uint32_t pin) {
+CurrentLimiter::PinState CurrentLimiter::getPinState(uint32_t pin) {
 	MutexLocker locker(_lock);
 
 	auto itr = _pinStates.find(pin);
@@ -117,34 +120,52 @@ void CurrentLimiter::updatePinConfiguration(const CurrentLimiter::PinConfigurati
 }
 
 void CurrentLimiter::enablePin(uint32_t pin) {
-	MutexLocker locker(_lock);
+	bool changed = false;
 
-	auto itr = _pinConfigurations.find(pin);
-	if (itr == _pinConfigurations.end()) {
-		throw RollerException("Cannot enable non-existent pin %u", pin);
-	}
+	{
+		MutexLocker locker(_lock);
 
-	PinState& state = _pinStates[pin];
+		auto itr = _pinConfigurations.find(pin);
+		if (itr == _pinConfigurations.end()) {
+			throw RollerException("Cannot enable non-existent pin %u", pin);
+		}
+
+		PinState& state = _pinStates[pin];
+
+		if (! state._desiredState) {
+			state._desiredState = true;
+			evaluateConfiguration();
+			changed = true;
+		}
+	}
 
-	if (! state._desiredState) {
-		state._desiredState = true;
-		evaluateConfiguration();
+	if (changed) {
+		firePinChangedEvent(pin, true);
 	}
 }
 
 void CurrentLimiter::disablePin(uint32_t pin) {
-	MutexLocker locker(_lock);
+	bool changed = false;
 
-	auto itr = _pinConfigurations.find(pin);
-	if (itr == _pinConfigurations.end()) {
-		throw RollerException("Cannot disable non-existent pin %u", pin);
-	}
+	{
+		MutexLocker locker(_lock);
 
-	PinState& state = _pinStates[pin];
+		auto itr = _pinConfigurations.find(pin);
+		if (itr == _pinConfigurations.end()) {
+			throw RollerException("Cannot disable non-existent pin %u", pin);
+		}
 
-	if (state._desiredState) {
-		state._desiredState = false;
-		evaluateConfiguration();
+		PinState& state = _pinStates[pin];
+
+		if (state._desiredState) {
+			state._desiredState = false;
+			evaluateConfiguration();
+			changed = true;
+		}
+	}
+
+	if (changed) {
+		firePinChangedEvent(pin, false);
 	}
 }
 
@@ -161,6 +182,52 @@ bool CurrentLimiter::isEnabled(uint32_t pin) {
 	return state._desiredState;
 }
 
+// getAvailableMilliAmps
+uint32_t CurrentLimiter::getAvailableMilliAmps(const std::set<uint32_t>& pins) {
+	MutexLocker locker(_lock);
+
+	double available = (double)_maxMilliAmps - (double)_baseMilliAmps;
+
+	for (const auto& entry : _pinConfigurations) {
+		const PinConfiguration& config = entry.second;
+		const PinState& state = _pinStates[config._pinNumber];
+
+		if (config._pwm) {
+			if (pins.find(config._pinNumber) == pins.end()) {
+				available -= ((double)config._milliAmps * (double)config._pwmLoad);
+			}
+		} else if (config._critical && state._enabled) {
+			available -= (double)config._milliAmps;
+		}
+	}
+
+	return (uint32_t)std::max(0.0, available);
+}
+
+// addPinListener
+Key CurrentLimiter::addPinListener(const PinListener& listener) {
+	MutexLocker locker(_listenerLock);
+	return _pinListeners.add(listener);
+}
+
+// removePinListener
+void CurrentLimiter::removePinListener(const Key& key) {
+	MutexLocker locker(_listenerLock);
+	_pinListeners.remove(key);
+}
+
+// firePinChangedEvent
+void CurrentLimiter::firePinChangedEvent(uint32_t pin, bool enabled) {
+	MutexLocker locker(_listenerLock);
+	for (auto callback : _pinListeners) {
+		try {
+			callback(pin, enabled);
+		} catch (const exception& e) {
+			Log::w("Caught exception in pin listener for pin %u (ignoring): %s", pin, e.what());
+		}
+	}
+}
+
 void CurrentLimiter::evaluateConfiguration() {
 
 	// TODO: the implementation here should really pre-calculate all pin states, and then
@@ -0,0 +1,97 @@
+#include "disturbance_compensator.h"
+
+#include <algorithm>
+
+using json = nlohmann::json;
+
+// setRule
+void DisturbanceCompensator::setRule( const DisturbanceRule& rule ) {
+	_rules[rule._source] = rule;
+}
+
+// removeRule
+void DisturbanceCompensator::removeRule( const std::string& source ) {
+	_rules.erase( source );
+	_elapsed.erase( source );
+}
+
+// getRules
+const std::map<std::string, DisturbanceRule>& DisturbanceCompensator::getRules() const {
+	return _rules;
+}
+
+// trigger
+void DisturbanceCompensator::trigger( const std::string& source ) {
+	if ( _rules.find( source ) != _rules.end() ) {
+		_elapsed[source] = 0.0f;
+	}
+}
+
+// update
+void DisturbanceCompensator::update( f32 dt ) {
+	for ( auto itr = _elapsed.begin(); itr != _elapsed.end(); ) {
+		itr->second += dt;
+		if ( getRemaining( itr->first ) <= 0.0f ) {
+			itr = _elapsed.erase( itr );
+		} else {
+			++itr;
+		}
+	}
+}
+
+// getBump
+f32 DisturbanceCompensator::getBump() const {
+	f32 bump = 0.0f;
+	for ( const auto& entry : _elapsed ) {
+		bump += (_rules.at( entry.first )._bump * getRemaining( entry.first ));
+	}
+	return bump;
+}
+
+// getGainScale
+f32 DisturbanceCompensator::getGainScale() const {
+	f32 gainScale = 1.0f;
+	for ( const auto& entry : _elapsed ) {
+		f32 ruleScale = _rules.at( entry.first )._gainScale;
+		gainScale *= (1.0f + ((ruleScale - 1.0f) * getRemaining( entry.first )));
+	}
+	return gainScale;
+}
+
+// isActive
+bool DisturbanceCompensator::isActive() const {
+	return ! _elapsed.empty();
+}
+
+// getRemaining
+f32 DisturbanceCompensator::getRemaining( const std::string& source ) const {
+	auto itr = _elapsed.find( source );
+	if ( itr == _elapsed.end() ) {
+		return 0.0f;
+	}
+
+	const DisturbanceRule& rule = _rules.at( source );
+	if ( rule._duration <= 0.0f ) {
+		return 0.0f;
+	}
+
+	return std::max( 0.0f, 1.0f - (itr->second / rule._duration) );
+}
+
+// to_json
+void to_json(json& j, const DisturbanceRule& rule) {
+	j = json {
+		{"bump", rule._bump},
+		{"duration", rule._duration},
+		{"gainScale", rule._gainScale}
+	};
+}
+
+// to_json
+void to_json(json& j, const DisturbanceCompensator& compensator) {
+	j = json {
+		{"rules", compensator.getRules()},
+		{"bump", compensator.getBump()},
+		{"gainScale", compensator.getGainScale()}
+	};
+}
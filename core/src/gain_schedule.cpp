@@ -0,0 +1,143 @@
+#include "gain_schedule.h"
+
+#include <algorithm>
+
+#include <roller/core/exception.h>
+#include <roller/core/serialization.h>
+#include <roller/core/util.h>
+
+using json = nlohmann::json;
+
+// Constructor
+GainSchedule::GainSchedule( Key key ) :
+				_key(key) {
+}
+
+// addEntry
+void GainSchedule::addEntry( const GainScheduleEntry& entry ) {
+
+	auto itr = std::lower_bound( _entries.begin(), _entries.end(), entry,
+			[]( const GainScheduleEntry& a, const GainScheduleEntry& b ) {
+				return a._operatingPoint < b._operatingPoint;
+			});
+
+	if ( itr != _entries.end() && itr->_operatingPoint == entry._operatingPoint ) {
+		*itr = entry;
+	} else {
+		_entries.insert( itr, entry );
+	}
+}
+
+// clear
+void GainSchedule::clear() {
+	_entries.clear();
+}
+
+// isEmpty
+bool GainSchedule::isEmpty() const {
+	return _entries.empty();
+}
+
+// getKey
+GainSchedule::Key GainSchedule::getKey() const {
+	return _key;
+}
+
+// getEntries
+const std::vector<GainScheduleEntry>& GainSchedule::getEntries() const {
+	return _entries;
+}
+
+// lookup
+GainScheduleEntry GainSchedule::lookup( f32 operatingPoint ) const {
+
+	if ( _entries.empty() ) {
+		throw RollerException( "Cannot look up gains in an empty gain schedule" );
+	}
+
+	if ( operatingPoint <= _entries.front()._operatingPoint ) {
+		return _entries.front();
+	}
+	if ( operatingPoint >= _entries.back()._operatingPoint ) {
+		return _entries.back();
+	}
+
+	// find the pair of entries straddling the operating point and interpolate
+	size_t upper = 1;
+	while ( _entries[upper]._operatingPoint < operatingPoint ) {
+		upper++;
+	}
+
+	const GainScheduleEntry& a = _entries[upper - 1];
+	const GainScheduleEntry& b = _entries[upper];
+	f32 alpha = (operatingPoint - a._operatingPoint) / (b._operatingPoint - a._operatingPoint);
+
+	GainScheduleEntry result;
+	result._operatingPoint = operatingPoint;
+	result._kp = a._kp + (alpha * (b._kp - a._kp));
+	result._ki = a._ki + (alpha * (b._ki - a._ki));
+	result._kd = a._kd + (alpha * (b._kd - a._kd));
+	result._errorAccumulationCap = a._errorAccumulationCap
+			+ (alpha * (b._errorAccumulationCap - a._errorAccumulationCap));
+
+	return result;
+}
+
+// parse
+GainSchedule GainSchedule::parse( const std::string& table, Key key ) {
+
+	GainSchedule schedule( key );
+
+	if ( table.empty() ) {
+		return schedule;
+	}
+
+	std::vector<std::string> rows = split( table, "," );
+	for ( const std::string& row : rows ) {
+		std::vector<std::string> fields = split( row, ":" );
+		if ( fields.size() != 5 ) {
+			throw RollerException( "Illegal gain schedule entry (%s), expected point:kp:ki:kd:cap", row.c_str() );
+		}
+
+		GainScheduleEntry entry;
+		entry._operatingPoint = Serialization::toF32( fields[0] );
+		entry._kp = Serialization::toF32( fields[1] );
+		entry._ki = Serialization::toF32( fields[2] );
+		entry._kd = Serialization::toF32( fields[3] );
+		entry._errorAccumulationCap = Serialization::toF32( fields[4] );
+		schedule.addEntry( entry );
+	}
+
+	return schedule;
+}
+
+// to_json
+void to_json(json& j, const GainScheduleEntry& entry) {
+	j = json {
+		{"operatingPoint", entry._operatingPoint},
+		{"kp", entry._kp},
+		{"ki", entry._ki},
+		{"kd", entry._kd},
+		{"errorAccumulationCap", entry._errorAccumulationCap}
+	};
+}
+
+// to_json
+void to_json(json& j, const GainSchedule::Key& key) {
+	switch (key) {
+		case GainSchedule::Key::SETPOINT:
+			j = "setpoint";
+			break;
+		case GainSchedule::Key::INPUT:
+			j = "input";
+			break;
+	}
+}
+
+// to_json
+void to_json(json& j, const GainSchedule& schedule) {
+	j = json {
+		{"key", schedule.getKey()},
+		{"entries", schedule.getEntries()}
+	};
+}
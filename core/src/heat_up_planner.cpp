@@ -0,0 +1,258 @@
+#include "heat_up_planner.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+using json = nlohmann::json;
+
+#define AB_PLANNER_SUM_WEIGHT 0.1f // weight of the sum of ETAs against the last ETA
+#define AB_PLANNER_UNREACHABLE_COST 1.0e6f // s, cost of a target that is never reached
+
+// waterFill: hand out milliAmps by weight, capping each vessel at its max load
+static f32 waterFill(
+		const std::vector<PlannerVessel>& vessels,
+		const std::vector<f32>& weights,
+		const std::vector<f32>& caps,
+		std::vector<bool>& capped,
+		f32 milliAmps,
+		std::vector<f32>& loads ) {
+
+	// each pass either hands out everything or caps at least one more vessel
+	for ( size_t pass = 0; pass < vessels.size() && milliAmps > 0.0f; pass++ ) {
+
+		f32 totalWeight = 0.0f;
+		for ( size_t i = 0; i < vessels.size(); i++ ) {
+			if ( ! capped[i] ) {
+				totalWeight += weights[i];
+			}
+		}
+		if ( totalWeight <= 0.0f ) {
+			break;
+		}
+
+		f32 remaining = milliAmps;
+		bool cappedAny = false;
+		for ( size_t i = 0; i < vessels.size(); i++ ) {
+			if ( capped[i] || weights[i] <= 0.0f ) {
+				continue;
+			}
+
+			f32 elementMilliAmps = std::max( 1.0f, vessels[i]._milliAmps );
+			f32 wanted = (caps[i] - loads[i]) * elementMilliAmps;
+			f32 offered = milliAmps * (weights[i] / totalWeight);
+			if ( offered >= wanted ) {
+				offered = wanted;
+				capped[i] = true;
+				cappedAny = true;
+			}
+
+			loads[i] += (offered / elementMilliAmps);
+			remaining -= offered;
+		}
+
+		milliAmps = std::max( 0.0f, remaining );
+		if ( ! cappedAny ) {
+			break;
+		}
+	}
+
+	return milliAmps;
+}
+
+// Constructor
+HeatUpPlanner::HeatUpPlanner( f32 stepDuration, i32 horizonSteps, i32 splitResolution ) :
+				_stepDuration(stepDuration),
+				_horizonSteps(std::max( 1, horizonSteps )),
+				_splitResolution(std::max( 1, splitResolution )),
+				_holdingTolerance(0.5f) {
+}
+
+// plan
+std::vector<PlannedLoad> HeatUpPlanner::plan( const std::vector<PlannerVessel>& vessels, f32 availableMilliAmps ) const {
+
+	std::vector<PlannedLoad> result( vessels.size() );
+
+	std::vector<f32> temps;
+	std::vector<bool> holding;
+	std::vector<size_t> heating;
+	for ( size_t i = 0; i < vessels.size(); i++ ) {
+		temps.push_back( vessels[i]._temp );
+		holding.push_back( vessels[i]._temp >= (vessels[i]._target - _holdingTolerance) );
+		if ( ! holding[i] ) {
+			heating.push_back( i );
+		}
+	}
+
+	// search over every split of the budget between the heating vessels
+	std::vector<f32> shares( vessels.size(), 0.0f );
+	std::vector<f32> bestShares( vessels.size(), 0.0f );
+	std::vector<f32> etas;
+	std::vector<f32> bestEtas( vessels.size(), 0.0f );
+	f32 bestCost = std::numeric_limits<f32>::max();
+
+	std::function<void( size_t, i32 )> search = [&]( size_t index, i32 remaining ) {
+		if ( index + 1 >= heating.size() ) {
+			if ( ! heating.empty() ) {
+				shares[heating[index]] = (f32)remaining / (f32)_splitResolution;
+			}
+
+			f32 cost = simulate( vessels, shares, availableMilliAmps, etas );
+			if ( cost < bestCost ) {
+				bestCost = cost;
+				bestShares = shares;
+				bestEtas = etas;
+			}
+			return;
+		}
+
+		for ( i32 part = 0; part <= remaining; part++ ) {
+			shares[heating[index]] = (f32)part / (f32)_splitResolution;
+			search( index + 1, remaining - part );
+		}
+	};
+	search( 0, _splitResolution );
+
+	std::vector<f32> loads;
+	allocate( vessels, temps, holding, bestShares, availableMilliAmps, loads );
+
+	for ( size_t i = 0; i < vessels.size(); i++ ) {
+		result[i]._load = loads[i];
+		result[i]._holding = holding[i];
+		result[i]._eta = bestEtas[i];
+	}
+
+	return result;
+}
+
+// allocate
+void HeatUpPlanner::allocate(
+		const std::vector<PlannerVessel>& vessels,
+		const std::vector<f32>& temps,
+		const std::vector<bool>& holding,
+		const std::vector<f32>& shares,
+		f32 availableMilliAmps,
+		std::vector<f32>& loads ) const {
+
+	loads.assign( vessels.size(), 0.0f );
+	std::vector<f32> caps( vessels.size(), 0.0f );
+	std::vector<bool> capped( vessels.size(), false );
+
+	// holding vessels come first; they only need to cover their losses
+	f32 milliAmps = availableMilliAmps;
+	for ( size_t i = 0; i < vessels.size(); i++ ) {
+		const ThermalModel& model = vessels[i]._model;
+		if ( holding[i] ) {
+			loads[i] = std::min( 1.0f, model.getSteadyStateLoad( vessels[i]._target ));
+			milliAmps -= (loads[i] * vessels[i]._milliAmps);
+			capped[i] = true;
+		} else {
+			// never more than what lands exactly on target at the end of the step
+			f32 cap = model.getLoadToReach( temps[i], vessels[i]._target, _stepDuration );
+			caps[i] = std::min( 1.0f, std::max( 0.0f, cap ));
+		}
+	}
+	milliAmps = std::max( 0.0f, milliAmps );
+
+	// heating vessels split what is left by share, then whatever a capped
+	// vessel could not use goes to the others
+	milliAmps = waterFill( vessels, shares, caps, capped, milliAmps, loads );
+
+	std::vector<f32> equalWeights( vessels.size(), 1.0f );
+	waterFill( vessels, equalWeights, caps, capped, milliAmps, loads );
+}
+
+// simulate
+f32 HeatUpPlanner::simulate(
+		const std::vector<PlannerVessel>& vessels,
+		const std::vector<f32>& shares,
+		f32 availableMilliAmps,
+		std::vector<f32>& etas ) const {
+
+	std::vector<f32> temps;
+	std::vector<bool> holding;
+	etas.assign( vessels.size(), -1.0f );
+	size_t numHolding = 0;
+
+	for ( size_t i = 0; i < vessels.size(); i++ ) {
+		temps.push_back( vessels[i]._temp );
+		holding.push_back( vessels[i]._temp >= (vessels[i]._target - _holdingTolerance) );
+		if ( holding[i] ) {
+			etas[i] = 0.0f;
+			numHolding++;
+		}
+	}
+
+	std::vector<f32> loads;
+	f32 time = 0.0f;
+	for ( i32 step = 0; step < _horizonSteps && numHolding < vessels.size(); step++ ) {
+
+		allocate( vessels, temps, holding, shares, availableMilliAmps, loads );
+
+		for ( size_t i = 0; i < vessels.size(); i++ ) {
+			if ( holding[i] ) {
+				continue;
+			}
+
+			const ThermalModel& model = vessels[i]._model;
+			f32 holdingTemp = vessels[i]._target - _holdingTolerance;
+			f32 nextTemp = model.getTempAfter( temps[i], loads[i], _stepDuration );
+
+			if ( nextTemp >= holdingTemp ) {
+				f32 arrival = model.getTimeToTemp( temps[i], holdingTemp, loads[i] );
+				etas[i] = time + (arrival >= 0.0f ? std::min( arrival, _stepDuration ) : _stepDuration);
+				holding[i] = true;
+				numHolding++;
+			}
+
+			temps[i] = nextTemp;
+		}
+
+		time += _stepDuration;
+	}
+
+	// past the horizon, assume each vessel gets its full element
+	f32 cost = 0.0f;
+	f32 sum = 0.0f;
+	for ( size_t i = 0; i < vessels.size(); i++ ) {
+		if ( ! holding[i] ) {
+			f32 remaining = vessels[i]._model.getTimeToTemp( temps[i], vessels[i]._target - _holdingTolerance, 1.0f );
+			etas[i] = (remaining >= 0.0f ? time + remaining : -1.0f);
+		}
+
+		f32 eta = (etas[i] >= 0.0f ? etas[i] : AB_PLANNER_UNREACHABLE_COST);
+		cost = std::max( cost, eta );
+		sum += eta;
+	}
+
+	return cost + (AB_PLANNER_SUM_WEIGHT * sum);
+}
+
+// setHoldingTolerance
+void HeatUpPlanner::setHoldingTolerance( f32 holdingTolerance ) {
+	_holdingTolerance = holdingTolerance;
+}
+
+// getHoldingTolerance
+f32 HeatUpPlanner::getHoldingTolerance() const {
+	return _holdingTolerance;
+}
+
+// getStepDuration
+f32 HeatUpPlanner::getStepDuration() const {
+	return _stepDuration;
+}
+
+// getHorizonSteps
+i32 HeatUpPlanner::getHorizonSteps() const {
+	return _horizonSteps;
+}
+
+// to_json
+void to_json(json& j, const PlannedLoad& plannedLoad) {
+	j = json {
+		{"load", plannedLoad._load},
+		{"holding", plannedLoad._holding},
+		{"eta", plannedLoad._eta}
+	};
+}
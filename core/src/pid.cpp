@@ -12,8 +12,13 @@ PID::PID( f32 kp, f32 ki, f32 kd, f32 setpoint, f32 minOutput, f32 maxOutput ) :
 				_minOutput(minOutput),
 				_maxOutput(maxOutput),
 				_errorAccumulationCap(1000.0f),
+				_trackingGain(0.0f),
+				_gainScale(1.0f),
+				_feedForward(0),
 				_lastInput(0),
 				_output(0),
+				_unclampedOutput(0),
+				_appliedOutput(0),
 				_errorSum(0),
 				_inputAccumulation(64) {
 }
@@ -23,6 +28,14 @@ f32 PID::update( f32 input, f32 dt ) {
 
 	_inputAccumulation.add( input );
 
+	// apply scheduled gains for the current operating point
+	if ( ! _gainSchedule.isEmpty() ) {
+		f32 operatingPoint = (_gainSchedule.getKey() == GainSchedule::Key::SETPOINT ? _setpoint : input);
+		GainScheduleEntry gains = _gainSchedule.lookup( operatingPoint );
+		setTunings( gains._kp, gains._ki, gains._kd );
+		_errorAccumulationCap = gains._errorAccumulationCap;
+	}
+
 	if ( dt > 1.0f ) {
 		static bool warnedOnce = false;
 		if ( warnedOnce ) {
@@ -38,12 +51,20 @@ f32 PID::update( f32 input, f32 dt ) {
 
 	f32 p = e;
 
+	// back-calculation: bleed the integrator by however much the last output
+	// was not actually applied (clamped, or scaled back by a current limiter)
+	if ( _ki > 0.0f ) {
+		f32 saturation = (_appliedOutput - _unclampedOutput);
+		_errorSum += ((_trackingGain * saturation * dt) / _ki);
+	}
+
 	// Log::f( "  _errorSum (%f) += (%f * %f) = %f", _errorSum, e, dt, (_errorSum + (e * dt)) );
 	_errorSum += (e * dt);
 	if (_errorSum > _errorAccumulationCap ) {
 		// Log::f( "  ** clamping I, too high" );
 		_errorSum = _errorAccumulationCap;
-	} else if (_errorAccumulationCap < (- _errorAccumulationCap)) {
+	} else if (_errorSum < (- _errorAccumulationCap)) {
+		// Log::f( "  ** clamping I, too low" );
 		_errorSum = (- _errorAccumulationCap);
 	}
 	f32 i = _errorSum;
@@ -57,7 +78,8 @@ f32 PID::update( f32 input, f32 dt ) {
 	}
 	*/
 
-	_output = (_kp * p) + (_ki * i) + (_kd * d);
+	_output = (_gainScale * _kp * p) + (_ki * i) + (_gainScale * _kd * d) + _feedForward;
+	_unclampedOutput = _output;
 	// Log::f( "  output: (%.2f * %.2f) + (%.2f * %.2f) + (%.2f * %.2f) = %f", _kp, p, _ki, i, _kd, d, _output );
 	if (_output > _maxOutput ) {
 		// Log::f( "  ** clamping output, too high" );
@@ -67,6 +89,9 @@ f32 PID::update( f32 input, f32 dt ) {
 		_output = _minOutput;
 	}
 
+	// assume the clamped output gets applied until told otherwise
+	_appliedOutput = _output;
+
 	return _output;
 }
 
@@ -75,6 +100,79 @@ f32 PID::getOutput() {
 	return _output;
 }
 
+// setAppliedOutput
+void PID::setAppliedOutput( f32 appliedOutput ) {
+	_appliedOutput = appliedOutput;
+}
+
+// setTrackingGain
+void PID::setTrackingGain( f32 trackingGain ) {
+	_trackingGain = trackingGain;
+}
+
+// getTrackingGain
+f32 PID::getTrackingGain() const {
+	return _trackingGain;
+}
+
+// setGainScale
+void PID::setGainScale( f32 gainScale ) {
+	_gainScale = gainScale;
+}
+
+// getGainScale
+f32 PID::getGainScale() const {
+	return _gainScale;
+}
+
+// setTunings
+void PID::setTunings( f32 kp, f32 ki, f32 kd ) {
+
+	// keep ki * errorSum constant so the output doesn't jump
+	if ( ki > 0.0f && _ki > 0.0f ) {
+		_errorSum *= (_ki / ki);
+	}
+
+	_kp = kp;
+	_ki = ki;
+	_kd = kd;
+}
+
+// getKp
+f32 PID::getKp() const {
+	return _kp;
+}
+
+// getKi
+f32 PID::getKi() const {
+	return _ki;
+}
+
+// getKd
+f32 PID::getKd() const {
+	return _kd;
+}
+
+// setGainSchedule
+void PID::setGainSchedule( const GainSchedule& gainSchedule ) {
+	_gainSchedule = gainSchedule;
+}
+
+// getGainSchedule
+const GainSchedule& PID::getGainSchedule() const {
+	return _gainSchedule;
+}
+
+// setFeedForward
+void PID::setFeedForward( f32 feedForward ) {
+	_feedForward = feedForward;
+}
+
+// getFeedForward
+f32 PID::getFeedForward() const {
+	return _feedForward;
+}
+
 // setErrorAccumulationCap
 void PID::setErrorAccumulationCap( f32 errorAccumulationCap ) {
 	_errorAccumulationCap = errorAccumulationCap;
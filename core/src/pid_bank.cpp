@@ -0,0 +1,297 @@
+#include "pid_bank.h"
+
+#include <algorithm>
+
+#include <roller/core/exception.h>
+
+/*
+ * SIMD abstraction. Each implementation provides a vector type (pidvec), a mask
+ * type (pidmask) and the handful of operations the update kernel needs. The
+ * kernel itself is written once, against these.
+ */
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+#define AB_PID_BANK_LANES 8
+#define AB_PID_BANK_IMPL "avx"
+
+typedef __m256 pidvec;
+typedef __m256 pidmask;
+
+static inline pidvec vload( const f32* p ) { return _mm256_loadu_ps( p ); }
+static inline void vstore( f32* p, pidvec v ) { _mm256_storeu_ps( p, v ); }
+static inline pidvec vset( f32 f ) { return _mm256_set1_ps( f ); }
+static inline pidvec vadd( pidvec a, pidvec b ) { return _mm256_add_ps( a, b ); }
+static inline pidvec vsub( pidvec a, pidvec b ) { return _mm256_sub_ps( a, b ); }
+static inline pidvec vmul( pidvec a, pidvec b ) { return _mm256_mul_ps( a, b ); }
+static inline pidvec vdiv( pidvec a, pidvec b ) { return _mm256_div_ps( a, b ); }
+static inline pidvec vmin( pidvec a, pidvec b ) { return _mm256_min_ps( a, b ); }
+static inline pidvec vmax( pidvec a, pidvec b ) { return _mm256_max_ps( a, b ); }
+static inline pidmask vgt( pidvec a, pidvec b ) { return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+static inline pidvec vselect( pidmask m, pidvec a, pidvec b ) { return _mm256_blendv_ps( b, a, m ); }
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define AB_PID_BANK_LANES 4
+#define AB_PID_BANK_IMPL "sse"
+
+typedef __m128 pidvec;
+typedef __m128 pidmask;
+
+static inline pidvec vload( const f32* p ) { return _mm_loadu_ps( p ); }
+static inline void vstore( f32* p, pidvec v ) { _mm_storeu_ps( p, v ); }
+static inline pidvec vset( f32 f ) { return _mm_set1_ps( f ); }
+static inline pidvec vadd( pidvec a, pidvec b ) { return _mm_add_ps( a, b ); }
+static inline pidvec vsub( pidvec a, pidvec b ) { return _mm_sub_ps( a, b ); }
+static inline pidvec vmul( pidvec a, pidvec b ) { return _mm_mul_ps( a, b ); }
+static inline pidvec vdiv( pidvec a, pidvec b ) { return _mm_div_ps( a, b ); }
+static inline pidvec vmin( pidvec a, pidvec b ) { return _mm_min_ps( a, b ); }
+static inline pidvec vmax( pidvec a, pidvec b ) { return _mm_max_ps( a, b ); }
+static inline pidmask vgt( pidvec a, pidvec b ) { return _mm_cmpgt_ps( a, b ); }
+static inline pidvec vselect( pidmask m, pidvec a, pidvec b ) {
+	return _mm_or_ps( _mm_and_ps( m, a ), _mm_andnot_ps( m, b ));
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+#define AB_PID_BANK_LANES 4
+#define AB_PID_BANK_IMPL "neon"
+
+typedef float32x4_t pidvec;
+typedef uint32x4_t pidmask;
+
+static inline pidvec vload( const f32* p ) { return vld1q_f32( p ); }
+static inline void vstore( f32* p, pidvec v ) { vst1q_f32( p, v ); }
+static inline pidvec vset( f32 f ) { return vdupq_n_f32( f ); }
+static inline pidvec vadd( pidvec a, pidvec b ) { return vaddq_f32( a, b ); }
+static inline pidvec vsub( pidvec a, pidvec b ) { return vsubq_f32( a, b ); }
+static inline pidvec vmul( pidvec a, pidvec b ) { return vmulq_f32( a, b ); }
+static inline pidvec vdiv( pidvec a, pidvec b ) {
+#if defined(__aarch64__)
+	return vdivq_f32( a, b );
+#else
+	// ARMv7 NEON has no divide; refine the reciprocal estimate to full precision
+	pidvec r = vrecpeq_f32( b );
+	r = vmulq_f32( vrecpsq_f32( b, r ), r );
+	r = vmulq_f32( vrecpsq_f32( b, r ), r );
+	return vmulq_f32( a, r );
+#endif
+}
+static inline pidvec vmin( pidvec a, pidvec b ) { return vminq_f32( a, b ); }
+static inline pidvec vmax( pidvec a, pidvec b ) { return vmaxq_f32( a, b ); }
+static inline pidmask vgt( pidvec a, pidvec b ) { return vcgtq_f32( a, b ); }
+static inline pidvec vselect( pidmask m, pidvec a, pidvec b ) { return vbslq_f32( m, a, b ); }
+
+#else
+
+#define AB_PID_BANK_LANES 1
+#define AB_PID_BANK_IMPL "scalar"
+
+typedef f32 pidvec;
+typedef bool pidmask;
+
+static inline pidvec vload( const f32* p ) { return *p; }
+static inline void vstore( f32* p, pidvec v ) { *p = v; }
+static inline pidvec vset( f32 f ) { return f; }
+static inline pidvec vadd( pidvec a, pidvec b ) { return a + b; }
+static inline pidvec vsub( pidvec a, pidvec b ) { return a - b; }
+static inline pidvec vmul( pidvec a, pidvec b ) { return a * b; }
+static inline pidvec vdiv( pidvec a, pidvec b ) { return a / b; }
+static inline pidvec vmin( pidvec a, pidvec b ) { return std::min( a, b ); }
+static inline pidvec vmax( pidvec a, pidvec b ) { return std::max( a, b ); }
+static inline pidmask vgt( pidvec a, pidvec b ) { return a > b; }
+static inline pidvec vselect( pidmask m, pidvec a, pidvec b ) { return m ? a : b; }
+
+#endif
+
+// Constructor
+PIDBank::PIDBank() :
+				_size(0),
+				_stride(0),
+				_historyIndex(0) {
+}
+
+// add
+size_t PIDBank::add( f32 kp, f32 ki, f32 kd, f32 setpoint, f32 minOutput, f32 maxOutput ) {
+
+	size_t loop = _size;
+	reserve( _size + 1 );
+	_size++;
+
+	// same defaults as PID
+	_kp[loop] = kp;
+	_ki[loop] = ki;
+	_kd[loop] = kd;
+	_setpoint[loop] = setpoint;
+	_minOutput[loop] = minOutput;
+	_maxOutput[loop] = maxOutput;
+	_errorAccumulationCap[loop] = 1000.0f;
+	_trackingGain[loop] = 0.0f;
+	_gainScale[loop] = 1.0f;
+
+	return loop;
+}
+
+// size
+size_t PIDBank::size() const {
+	return _size;
+}
+
+// update
+void PIDBank::update( const f32* inputs, f32 dt ) {
+
+	std::copy( inputs, inputs + _size, _input.begin() );
+
+	// advance the shared history slot; each loop tracks how many slots it has filled
+	size_t slot = _historyIndex;
+	_historyIndex = ((_historyIndex + 1) % AB_PID_BANK_HISTORY_SIZE);
+
+	const pidvec zero = vset( 0.0f );
+	const pidvec one = vset( 1.0f );
+	const pidvec historySize = vset( (f32)AB_PID_BANK_HISTORY_SIZE );
+	const pidvec vdt = vset( dt );
+
+	for ( size_t i = 0; i < _stride; i += AB_PID_BANK_LANES ) {
+
+		pidvec input = vload( &_input[i] );
+
+		// record input in the history (same as PID's input accumulation)
+		vstore( &_history[(slot * _stride) + i], input );
+		pidvec count = vmin( vadd( vload( &_historyCount[i] ), one ), historySize );
+		vstore( &_historyCount[i], count );
+
+		pidvec gainScale = vload( &_gainScale[i] );
+		pidvec kp = vmul( gainScale, vload( &_kp[i] ));
+		pidvec ki = vload( &_ki[i] );
+		pidvec kd = vmul( gainScale, vload( &_kd[i] ));
+		pidvec cap = vload( &_errorAccumulationCap[i] );
+
+		// P
+		pidvec e = vsub( vload( &_setpoint[i] ), input );
+
+		// I, with back-calculation when ki > 0
+		pidvec errorSum = vload( &_errorSum[i] );
+		pidmask hasKi = vgt( ki, zero );
+		pidvec saturation = vsub( vload( &_appliedOutput[i] ), vload( &_unclampedOutput[i] ));
+		pidvec backCalc = vdiv(
+				vmul( vmul( vload( &_trackingGain[i] ), saturation ), vdt ),
+				vselect( hasKi, ki, one ));
+		errorSum = vadd( errorSum, vselect( hasKi, backCalc, zero ));
+		errorSum = vadd( errorSum, vmul( e, vdt ));
+		errorSum = vmax( vmin( errorSum, cap ), vsub( zero, cap ));
+		vstore( &_errorSum[i], errorSum );
+
+		// D, on the averaged input
+		pidvec sum = zero;
+		for ( size_t h = 0; h < AB_PID_BANK_HISTORY_SIZE; h++ ) {
+			sum = vadd( sum, vload( &_history[(h * _stride) + i] ));
+		}
+		pidvec filteredInput = vdiv( sum, vmax( count, one ));
+		pidvec d = vdiv( vsub( filteredInput, vload( &_lastInput[i] )), vdt );
+		vstore( &_lastInput[i], filteredInput );
+
+		// output
+		pidvec output = vadd( vadd( vadd( vmul( kp, e ), vmul( ki, errorSum )), vmul( kd, d )),
+				vload( &_feedForward[i] ));
+		vstore( &_unclampedOutput[i], output );
+		output = vmax( vmin( output, vload( &_maxOutput[i] )), vload( &_minOutput[i] ));
+		vstore( &_output[i], output );
+
+		// assume the clamped output gets applied until told otherwise
+		vstore( &_appliedOutput[i], output );
+	}
+}
+
+// getOutput
+f32 PIDBank::getOutput( size_t loop ) const {
+	return _output.at( loop );
+}
+
+// getOutputs
+const f32* PIDBank::getOutputs() const {
+	return _output.data();
+}
+
+// setAppliedOutput
+void PIDBank::setAppliedOutput( size_t loop, f32 appliedOutput ) {
+	_appliedOutput.at( loop ) = appliedOutput;
+}
+
+// setTunings
+void PIDBank::setTunings( size_t loop, f32 kp, f32 ki, f32 kd ) {
+
+	// keep ki * errorSum constant so the output doesn't jump (as PID does)
+	if ( ki > 0.0f && _ki.at( loop ) > 0.0f ) {
+		_errorSum[loop] *= (_ki[loop] / ki);
+	}
+
+	_kp.at( loop ) = kp;
+	_ki.at( loop ) = ki;
+	_kd.at( loop ) = kd;
+}
+
+// setSetpoint
+void PIDBank::setSetpoint( size_t loop, f32 setpoint ) {
+	_setpoint.at( loop ) = setpoint;
+}
+
+// setFeedForward
+void PIDBank::setFeedForward( size_t loop, f32 feedForward ) {
+	_feedForward.at( loop ) = feedForward;
+}
+
+// setErrorAccumulationCap
+void PIDBank::setErrorAccumulationCap( size_t loop, f32 errorAccumulationCap ) {
+	_errorAccumulationCap.at( loop ) = errorAccumulationCap;
+}
+
+// setTrackingGain
+void PIDBank::setTrackingGain( size_t loop, f32 trackingGain ) {
+	_trackingGain.at( loop ) = trackingGain;
+}
+
+// setGainScale
+void PIDBank::setGainScale( size_t loop, f32 gainScale ) {
+	_gainScale.at( loop ) = gainScale;
+}
+
+// getImplementation
+const char* PIDBank::getImplementation() {
+	return AB_PID_BANK_IMPL;
+}
+
+// reserve
+void PIDBank::reserve( size_t loops ) {
+
+	if ( loops <= _stride ) {
+		return;
+	}
+
+	// grow geometrically, rounded up to the SIMD width
+	size_t stride = std::max( loops, _stride * 2 );
+	stride = (((stride + AB_PID_BANK_LANES - 1) / AB_PID_BANK_LANES) * AB_PID_BANK_LANES);
+
+	for ( std::vector<f32>* array : {
+			&_kp, &_ki, &_kd, &_setpoint, &_minOutput, &_maxOutput,
+			&_errorAccumulationCap, &_trackingGain, &_gainScale, &_feedForward,
+			&_lastInput, &_output, &_unclampedOutput, &_appliedOutput, &_errorSum,
+			&_input, &_historyCount } ) {
+		array->resize( stride, 0.0f );
+	}
+
+	// history rows are laid out by stride, so they have to be moved
+	std::vector<f32> history( AB_PID_BANK_HISTORY_SIZE * stride, 0.0f );
+	for ( size_t h = 0; h < AB_PID_BANK_HISTORY_SIZE; h++ ) {
+		for ( size_t i = 0; i < _stride; i++ ) {
+			history[(h * stride) + i] = _history[(h * _stride) + i];
+		}
+	}
+	_history.swap( history );
+
+	_stride = stride;
+}
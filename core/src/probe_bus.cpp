@@ -0,0 +1,306 @@
+#include "probe_bus.h"
+
+#include <algorithm>
+
+#include <roller/core/log.h>
+#include <roller/core/util.h>
+
+using json = nlohmann::json;
+
+#define AB_PROBE_BUS_AVG_WEIGHT 0.1f // weight of the latest sweep in the average duration
+
+// Constructor
+ProbeBus::ProbeBus( const StringId& managerId, const ReadingCallback& callback ) :
+				_managerId(managerId),
+				_callback(callback),
+				_running(true),
+				_sweepRequested(false),
+				_sweepRequestedAt(0),
+				_sweeping(false),
+				_readTimeout(3000),
+				_reader(new ProbeReader()),
+				_backgroundReader(new ProbeReader()),
+				_thread( std::bind( &ProbeBus::run, this )) {
+	_stats._id = managerId;
+	_thread.run();
+}
+
+// Destructor
+ProbeBus::~ProbeBus() {
+	stop();
+	_thread.join();
+}
+
+// setProbes
+void ProbeBus::setProbes( const std::vector<StringId>& sensorIds ) {
+	std::lock_guard<std::mutex> locker( _lock );
+	_stats._numProbes = (i32)sensorIds.size();
+}
+
+// setBulkReader
+void ProbeBus::setBulkReader( const std::shared_ptr<BulkTemperatureReader>& reader ) {
+	std::lock_guard<std::mutex> locker( _lock );
+	_bulkReader = reader;
+}
+
+// setReadTimeout
+void ProbeBus::setReadTimeout( i32 readTimeout ) {
+	std::lock_guard<std::mutex> locker( _lock );
+	_readTimeout = readTimeout;
+}
+
+// requestSweep
+bool ProbeBus::requestSweep( const std::vector<BusProbe>& probes ) {
+	std::lock_guard<std::mutex> locker( _lock );
+
+	if ( _sweeping || _sweepRequested ) {
+		_stats._numSkippedSweeps++;
+		return false;
+	}
+
+	_sweepRequested = true;
+	_sweepRequestedAt = getTime();
+	_sweepProbes = probes;
+	_condition.notify_all();
+	return true;
+}
+
+// stop
+void ProbeBus::stop() {
+	std::lock_guard<std::mutex> locker( _lock );
+	_running = false;
+	_condition.notify_all();
+}
+
+// getStats
+BusStats ProbeBus::getStats() const {
+	std::lock_guard<std::mutex> locker( _lock );
+	return _stats;
+}
+
+// run
+void ProbeBus::run() {
+
+	while ( true ) {
+		{
+			std::unique_lock<std::mutex> locker( _lock );
+			_condition.wait( locker, [this]() {
+				return (! _running || _sweepRequested);
+			});
+
+			if ( ! _running ) {
+				break;
+			}
+
+			_sweepRequested = false;
+			_sweeping = true;
+		}
+
+		sweep();
+
+		std::lock_guard<std::mutex> locker( _lock );
+		_sweeping = false;
+	}
+}
+
+// sweep
+void ProbeBus::sweep() {
+
+	std::vector<BusProbe> requested;
+	i64 issued;
+	std::shared_ptr<BulkTemperatureReader> bulkReader;
+	{
+		std::lock_guard<std::mutex> locker( _lock );
+		requested = _sweepProbes;
+		issued = _sweepRequestedAt;
+		bulkReader = _bulkReader;
+	}
+
+	i64 start = getTime();
+
+	collectBackgroundReads();
+
+	std::vector<BusProbe> probes;
+	for ( const BusProbe& probe : requested ) {
+		if ( probe._background ) {
+			startBackgroundRead( probe );
+		} else {
+			probes.push_back( probe );
+		}
+	}
+
+	if ( bulkReader ) {
+
+		// one read for the whole bus
+		auto sensorIds = std::make_shared<std::vector<StringId>>();
+		for ( const BusProbe& probe : probes ) {
+			sensorIds->push_back( probe._id );
+		}
+
+		auto samples = std::make_shared<std::vector<BulkSample>>();
+		std::string error;
+		runWithTimeout( _hungBulkRead, [bulkReader, sensorIds, samples]() {
+			bulkReader->readAll( *sensorIds, *samples );
+		}, error );
+
+		for ( size_t i = 0; i < probes.size(); i++ ) {
+			if ( error.empty() && i < samples->size() && (*samples)[i]._valid ) {
+				_callback( probes[i]._handle, true, (*samples)[i]._temp, (*samples)[i]._time, issued, "" );
+			} else {
+				_callback( probes[i]._handle, false, 0, 0, issued, (error.empty() ? "not read" : error) );
+			}
+		}
+
+	} else {
+
+		// one read per probe
+		for ( const BusProbe& probe : probes ) {
+			if ( ! probe._sensor ) {
+				_callback( probe._handle, false, 0, 0, 0, "no sensor" );
+				continue;
+			}
+
+			if ( probe._handle >= (ProbeHandle)_hungReads.size() ) {
+				_hungReads.resize( probe._handle + 1 );
+			}
+
+			auto sample = std::make_shared<BulkSample>();
+			auto sensor = probe._sensor;
+			std::string error;
+			bool success = runWithTimeout( _hungReads[probe._handle], [sensor, sample]() {
+				sample->_temp = sensor->getTemperature( sample->_time );
+			}, error );
+
+			// an abandoned read may still write its sample
+			if ( success ) {
+				_callback( probe._handle, true, sample->_temp, sample->_time, issued, "" );
+			} else {
+				_callback( probe._handle, false, 0, 0, issued, error );
+			}
+		}
+	}
+
+	i64 duration = getTime() - start;
+
+	std::lock_guard<std::mutex> locker( _lock );
+	_stats._numSweeps++;
+	_stats._lastSweep = getTime();
+	_stats._lastSweepDuration = duration;
+	_stats._maxSweepDuration = std::max( _stats._maxSweepDuration, duration );
+	if ( _stats._numSweeps == 1 ) {
+		_stats._avgSweepDuration = (f32)duration;
+	} else {
+		_stats._avgSweepDuration += (AB_PROBE_BUS_AVG_WEIGHT * ((f32)duration - _stats._avgSweepDuration));
+	}
+}
+
+// startBackgroundRead
+void ProbeBus::startBackgroundRead( const BusProbe& probe ) {
+
+	if ( ! probe._sensor ) {
+		_callback( probe._handle, false, 0, 0, 0, "no sensor" );
+		return;
+	}
+
+	if ( probe._handle >= (ProbeHandle)_backgroundReads.size() ) {
+		_backgroundReads.resize( probe._handle + 1 );
+	}
+
+	std::shared_ptr<BackgroundRead>& pending = _backgroundReads[probe._handle];
+	if ( pending ) {
+		_callback( probe._handle, false, 0, 0, 0, "previous read still pending" );
+		return;
+	}
+
+	// the job only touches what it owns, so an abandoned reader can finish it
+	pending = std::make_shared<BackgroundRead>();
+	auto read = pending;
+	auto sensor = probe._sensor;
+	read->_job = _backgroundReader->post( [read, sensor]() {
+		read->_sample._temp = sensor->getTemperature( read->_sample._time );
+	});
+}
+
+// collectBackgroundReads
+void ProbeBus::collectBackgroundReads() {
+
+	for ( size_t i = 0; i < _backgroundReads.size(); i++ ) {
+		std::shared_ptr<BackgroundRead>& read = _backgroundReads[i];
+		if ( ! read || ! read->_job->_done.load( std::memory_order_acquire )) {
+			continue;
+		}
+
+		const std::string& error = read->_job->_error;
+		_callback( (ProbeHandle)i, error.empty(), read->_sample._temp, read->_sample._time, read->_job->_started, error );
+		read.reset();
+	}
+
+	i32 readTimeout;
+	{
+		std::lock_guard<std::mutex> locker( _lock );
+		readTimeout = _readTimeout;
+	}
+
+	// a hung read keeps its probe pending until it returns; the rest move on
+	i64 busySince = _backgroundReader->getBusySince();
+	if ( busySince != 0 && getTime() - busySince > readTimeout ) {
+		std::vector<std::shared_ptr<ProbeReader::Job>> queued = _backgroundReader->takeQueued();
+		_backgroundReader.reset( new ProbeReader() );
+		for ( auto& job : queued ) {
+			_backgroundReader->post( job );
+		}
+
+		std::lock_guard<std::mutex> locker( _lock );
+		_stats._numTimeouts++;
+	}
+}
+
+// runWithTimeout
+bool ProbeBus::runWithTimeout( std::shared_ptr<ProbeReader::Job>& hung, const std::function<void()>& read, std::string& error ) {
+
+	// don't give up another reader on a read that is still hung
+	if ( hung ) {
+		if ( ! hung->_done.load( std::memory_order_acquire )) {
+			error = "previous read still hung";
+			return false;
+		}
+		hung.reset();
+	}
+
+	i32 readTimeout;
+	{
+		std::lock_guard<std::mutex> locker( _lock );
+		readTimeout = _readTimeout;
+	}
+
+	std::shared_ptr<ProbeReader::Job> job = _reader->post( read );
+	if ( ! _reader->wait( job, readTimeout )) {
+		hung = job;
+		error = "read timed out";
+
+		// the old reader finishes the read, if ever, then exits
+		_reader.reset( new ProbeReader() );
+
+		std::lock_guard<std::mutex> locker( _lock );
+		_stats._numTimeouts++;
+		return false;
+	}
+
+	error = job->_error;
+	return error.empty();
+}
+
+// to_json
+void to_json(json& j, const BusStats& stats) {
+	j = json {
+		{"id", stats._id.getString()},
+		{"probes", stats._numProbes},
+		{"sweeps", stats._numSweeps},
+		{"skippedSweeps", stats._numSkippedSweeps},
+		{"timeouts", stats._numTimeouts},
+		{"lastSweep", stats._lastSweep},
+		{"lastSweepDuration", stats._lastSweepDuration},
+		{"maxSweepDuration", stats._maxSweepDuration},
+		{"avgSweepDuration", stats._avgSweepDuration}
+	};
+}
@@ -0,0 +1,119 @@
+#include "probe_reader.h"
+
+#include <chrono>
+
+#include <roller/core/util.h>
+
+// Constructor
+ProbeReader::ProbeReader() :
+				_state(std::make_shared<State>()) {
+	_thread = std::thread( &ProbeReader::run, _state );
+}
+
+// Destructor
+ProbeReader::~ProbeReader() {
+
+	std::deque<std::shared_ptr<Job>> jobs;
+	bool busy;
+	{
+		std::lock_guard<std::mutex> locker( _state->_lock );
+		_state->_stopping = true;
+		jobs.swap( _state->_jobs );
+		busy = (_state->_busySince != 0);
+	}
+	_state->_condition.notify_all();
+
+	for ( auto& job : jobs ) {
+		job->_error = "reader stopped";
+		job->_done.store( true, std::memory_order_release );
+	}
+
+	// a thread in a read may never come back; it exits once it does
+	if ( busy ) {
+		_thread.detach();
+	} else {
+		_thread.join();
+	}
+}
+
+// post
+std::shared_ptr<ProbeReader::Job> ProbeReader::post( const std::function<void()>& read ) {
+	auto job = std::make_shared<Job>( read );
+	post( job );
+	return job;
+}
+
+// post
+void ProbeReader::post( const std::shared_ptr<Job>& job ) {
+	{
+		std::lock_guard<std::mutex> locker( _state->_lock );
+		_state->_jobs.push_back( job );
+	}
+	_state->_condition.notify_all();
+}
+
+// wait
+bool ProbeReader::wait( const std::shared_ptr<Job>& job, i32 timeout ) {
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeout );
+
+	std::unique_lock<std::mutex> locker( _state->_lock );
+	return _state->_condition.wait_until( locker, deadline, [&job]() {
+		return job->_done.load( std::memory_order_acquire );
+	});
+}
+
+// getBusySince
+i64 ProbeReader::getBusySince() const {
+	std::lock_guard<std::mutex> locker( _state->_lock );
+	return _state->_busySince;
+}
+
+// takeQueued
+std::vector<std::shared_ptr<ProbeReader::Job>> ProbeReader::takeQueued() {
+	std::lock_guard<std::mutex> locker( _state->_lock );
+	std::vector<std::shared_ptr<Job>> jobs( _state->_jobs.begin(), _state->_jobs.end() );
+	_state->_jobs.clear();
+	return jobs;
+}
+
+// run
+void ProbeReader::run( std::shared_ptr<State> state ) {
+
+	while ( true ) {
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> locker( state->_lock );
+			state->_condition.wait( locker, [&state]() {
+				return (state->_stopping || ! state->_jobs.empty());
+			});
+
+			if ( state->_stopping ) {
+				break;
+			}
+
+			job = state->_jobs.front();
+			state->_jobs.pop_front();
+			state->_busySince = getTime();
+			job->_started = state->_busySince;
+		}
+
+		try {
+			job->_read();
+		} catch ( const exception& e ) {
+			job->_error = e.what();
+			if ( job->_error.empty() ) {
+				job->_error = "unknown error";
+			}
+		} catch ( ... ) {
+			job->_error = "unrecognized exception";
+		}
+
+		{
+			std::lock_guard<std::mutex> locker( state->_lock );
+			job->_done.store( true, std::memory_order_release );
+			state->_busySince = 0;
+		}
+		state->_condition.notify_all();
+	}
+}
@@ -0,0 +1,132 @@
+#include "sample_filter.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#define AB_POWER_ON_TEMP 85000 // mC, what a DS18B20 reads before its first conversion
+#define AB_POWER_ON_TOLERANCE 1000 // mC, how near 85 C a probe must be for 85 C to be believed
+
+// Constructor
+SampleFilter::SampleFilter( const SampleFilterSettings& settings ) :
+				_settings(settings) {
+	reset();
+}
+
+// reset
+void SampleFilter::reset() {
+	for ( i32 i = 0; i < 3; i++ ) {
+		_samples[i] = 0;
+		_times[i] = 0;
+	}
+	_count = 0;
+	_next = 0;
+	_rejections = 0;
+	_powerOnPending = false;
+}
+
+// add
+SampleFilter::Result SampleFilter::add( i32 temp, i64 time ) {
+
+	if ( temp < _settings._minTemp || temp > _settings._maxTemp ) {
+		return Result::OUT_OF_RANGE;
+	}
+
+	if ( _count > 0 && _rejections >= _settings._maxRejections ) {
+		// what we keep rejecting is where the probe is now
+		reset();
+	}
+
+	i32 last = _samples[(_next + 2) % 3];
+	i64 lastTime = _times[(_next + 2) % 3];
+
+	Result result = Result::ACCEPTED;
+	if ( _count == 0 ) {
+		if ( temp == AB_POWER_ON_TEMP && !_powerOnPending ) {
+			// can't tell yet; believe it if the next sample is near 85 C too
+			_powerOnPending = true;
+			result = Result::POWER_ON_VALUE;
+		}
+	} else if ( temp == AB_POWER_ON_TEMP && std::abs( last - temp ) > AB_POWER_ON_TOLERANCE ) {
+		result = Result::POWER_ON_VALUE;
+	} else {
+		f64 dt = std::max( (f64)0.0, (f64)(time - lastTime) / 1000.0 );
+		if ( std::abs( temp - last ) > _settings._maxStep + _settings._maxRate * dt ) {
+			result = Result::TOO_FAST;
+		}
+	}
+
+	if ( result != Result::ACCEPTED ) {
+		_rejections++;
+		return result;
+	}
+
+	_samples[_next] = temp;
+	_times[_next] = time;
+	_next = (_next + 1) % 3;
+	_count = std::min( _count + 1, 3 );
+	_rejections = 0;
+	_powerOnPending = false;
+	return result;
+}
+
+// getFilteredIndex
+i32 SampleFilter::getFilteredIndex() const {
+
+	i32 latest = (_next + 2) % 3;
+	if ( _count < 3 ) {
+		return latest;
+	}
+
+	// the median; on ties, the newest of the equal samples
+	for ( i32 i = 0; i < 3; i++ ) {
+		i32 index = (latest + 3 - i) % 3;
+		i32 below = 0;
+		i32 above = 0;
+		for ( i32 j = 0; j < 3; j++ ) {
+			if ( j != index && _samples[j] < _samples[index] ) {
+				below++;
+			} else if ( j != index && _samples[j] > _samples[index] ) {
+				above++;
+			}
+		}
+		if ( below <= 1 && above <= 1 ) {
+			return index;
+		}
+	}
+	return latest;
+}
+
+// getFiltered
+i32 SampleFilter::getFiltered() const {
+	return _samples[getFilteredIndex()];
+}
+
+// getFilteredTime
+i64 SampleFilter::getFilteredTime() const {
+	return _times[getFilteredIndex()];
+}
+
+// setSettings
+void SampleFilter::setSettings( const SampleFilterSettings& settings ) {
+	_settings = settings;
+}
+
+// getSettings
+const SampleFilterSettings& SampleFilter::getSettings() const {
+	return _settings;
+}
+
+// getResultName
+const char* SampleFilter::getResultName( Result result ) {
+	switch ( result ) {
+		case Result::ACCEPTED:
+			return "accepted";
+		case Result::OUT_OF_RANGE:
+			return "out of range";
+		case Result::POWER_ON_VALUE:
+			return "power-on value";
+		case Result::TOO_FAST:
+			return "changed too fast";
+	}
+	return "unknown";
+}
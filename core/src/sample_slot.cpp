@@ -0,0 +1,94 @@
+#include "sample_slot.h"
+
+#include <thread>
+
+#include "temperature_manager.h"
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// Constructor
+SampleSlot::SampleSlot( const StringId& sensorId, ProbeHandle handle ) :
+				_id(sensorId),
+				_handle(handle),
+				_sequence(0),
+				_lastTemp(0),
+				_rawTemp(0),
+				_firstSeen(0),
+				_lastSeen(0),
+				_numSuccess(0),
+				_numErrors(0),
+				_numRejected(0),
+				_pollInterval(0),
+				_resolution(0),
+				_active(false),
+				_health(0),
+				_priority((i32)ProbePriority::NORMAL),
+				_sampleAge(0) {
+}
+
+// store
+void SampleSlot::store( const ProbeStats& stats ) {
+
+	uint32_t sequence = _sequence.load( memory_order_relaxed );
+	_sequence.store( sequence + 1, memory_order_relaxed );
+	std::atomic_thread_fence( memory_order_release );
+
+	_lastTemp.store( stats._lastTemp, memory_order_relaxed );
+	_rawTemp.store( stats._rawTemp, memory_order_relaxed );
+	_firstSeen.store( stats._firstSeen, memory_order_relaxed );
+	_lastSeen.store( stats._lastSeen, memory_order_relaxed );
+	_numSuccess.store( stats._numSuccess, memory_order_relaxed );
+	_numErrors.store( stats._numErrors, memory_order_relaxed );
+	_numRejected.store( stats._numRejected, memory_order_relaxed );
+	_pollInterval.store( stats._pollInterval, memory_order_relaxed );
+	_resolution.store( stats._resolution, memory_order_relaxed );
+	_active.store( stats._active, memory_order_relaxed );
+	_health.store( (i32)stats._health, memory_order_relaxed );
+	_priority.store( (i32)stats._priority, memory_order_relaxed );
+	_sampleAge.store( stats._sampleAge, memory_order_relaxed );
+
+	_sequence.store( sequence + 2, memory_order_release );
+}
+
+// load
+ProbeStats SampleSlot::load() const {
+
+	ProbeStats stats;
+	stats._id = _id;
+	stats._handle = _handle;
+
+	while ( true ) {
+		uint32_t before = _sequence.load( memory_order_acquire );
+		if ( before & 1 ) {
+			// the writer was preempted mid store
+			std::this_thread::yield();
+			continue;
+		}
+
+		stats._lastTemp = _lastTemp.load( memory_order_relaxed );
+		stats._rawTemp = _rawTemp.load( memory_order_relaxed );
+		stats._firstSeen = _firstSeen.load( memory_order_relaxed );
+		stats._lastSeen = _lastSeen.load( memory_order_relaxed );
+		stats._numSuccess = _numSuccess.load( memory_order_relaxed );
+		stats._numErrors = _numErrors.load( memory_order_relaxed );
+		stats._numRejected = _numRejected.load( memory_order_relaxed );
+		stats._pollInterval = _pollInterval.load( memory_order_relaxed );
+		stats._resolution = _resolution.load( memory_order_relaxed );
+		stats._active = _active.load( memory_order_relaxed );
+		stats._health = (ProbeHealth)_health.load( memory_order_relaxed );
+		stats._priority = (ProbePriority)_priority.load( memory_order_relaxed );
+		stats._sampleAge = _sampleAge.load( memory_order_relaxed );
+
+		std::atomic_thread_fence( memory_order_acquire );
+		if ( _sequence.load( memory_order_relaxed ) == before ) {
+			return stats;
+		}
+	}
+}
+
+// getId
+const StringId& SampleSlot::getId() const {
+	return _id;
+}
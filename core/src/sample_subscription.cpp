@@ -0,0 +1,64 @@
+#include "sample_subscription.h"
+
+#include <chrono>
+
+// Constructor
+SampleSubscription::SampleSubscription( TemperatureManager& temperatureManager ) :
+				_temperatureManager(temperatureManager),
+				_woken(false) {
+	_listenerKey = _temperatureManager.addStatsListener(
+			std::bind( &SampleSubscription::onProbeStatsChanged, this,
+					std::placeholders::_1, std::placeholders::_2 ));
+}
+
+// Destructor
+SampleSubscription::~SampleSubscription() {
+	_temperatureManager.removeStatsListener( _listenerKey );
+}
+
+// waitForSamples
+bool SampleSubscription::waitForSamples( i32 timeoutMs, map<StringId, ProbeStats>& samples ) {
+
+	samples.clear();
+
+	std::unique_lock<std::mutex> locker( _lock );
+	_condition.wait_for( locker, std::chrono::milliseconds( timeoutMs ), [this]() {
+		return (! _pending.empty() || _woken);
+	});
+
+	_woken = false;
+	samples.swap( _pending );
+
+	for ( const auto& entry : samples ) {
+		_lastDelivered[entry.first] = entry.second._lastSeen;
+	}
+
+	return ! samples.empty();
+}
+
+// wake
+void SampleSubscription::wake() {
+	std::lock_guard<std::mutex> locker( _lock );
+	_woken = true;
+	_condition.notify_all();
+}
+
+// onProbeStatsChanged
+void SampleSubscription::onProbeStatsChanged( const ProbeStats& before, const ProbeStats& after ) {
+
+	// only successful reads count
+	if ( after._numSuccess == before._numSuccess ) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> locker( _lock );
+
+	// drop stale and duplicate samples
+	auto itr = _lastDelivered.find( after._id );
+	if ( itr != _lastDelivered.end() && after._lastSeen <= itr->second ) {
+		return;
+	}
+
+	_pending[after._id] = after;
+	_condition.notify_all();
+}
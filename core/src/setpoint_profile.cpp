@@ -0,0 +1,215 @@
+#include "setpoint_profile.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <roller/core/exception.h>
+#include <roller/core/serialization.h>
+#include <roller/core/util.h>
+
+using json = nlohmann::json;
+
+// Constructor
+SetpointProfile::SetpointProfile() :
+				_phase(Phase::IDLE),
+				_stepIndex(0),
+				_setpoint(0.0f),
+				_soakElapsed(0.0f),
+				_tolerance(0.5f) {
+}
+
+// start
+void SetpointProfile::start( const std::vector<ProfileStep>& steps, f32 initialSetpoint ) {
+
+	if ( steps.empty() ) {
+		throw RollerException( "Cannot start a setpoint profile with no steps" );
+	}
+
+	_steps = steps;
+	_stepIndex = 0;
+	_setpoint = initialSetpoint;
+	_soakElapsed = 0.0f;
+	_phase = Phase::RAMPING;
+}
+
+// stop
+void SetpointProfile::stop() {
+	_phase = Phase::IDLE;
+}
+
+// update
+f32 SetpointProfile::update( f32 temp, f32 dt ) {
+
+	if ( ! isActive() ) {
+		return _setpoint;
+	}
+
+	const ProfileStep& step = _steps[_stepIndex];
+
+	switch ( _phase ) {
+	case Phase::RAMPING: {
+		f32 remaining = step._target - _setpoint;
+		f32 maxChange = (step._rampRate / 60.0f) * dt;
+
+		if ( step._rampRate <= 0.0f || std::fabs( remaining ) <= maxChange ) {
+			_setpoint = step._target;
+			_phase = Phase::WAITING;
+		} else {
+			_setpoint += (remaining > 0.0f ? maxChange : -maxChange);
+		}
+		break;
+	}
+
+	case Phase::WAITING:
+		if ( std::fabs( temp - step._target ) <= _tolerance ) {
+			_soakElapsed = 0.0f;
+			_phase = Phase::SOAKING;
+		}
+		break;
+
+	case Phase::SOAKING:
+		_soakElapsed += dt;
+		if ( _soakElapsed >= step._soakDuration ) {
+			_stepIndex++;
+			if ( _stepIndex >= _steps.size() ) {
+				_stepIndex = (_steps.size() - 1);
+				_phase = Phase::DONE;
+			} else {
+				_phase = Phase::RAMPING;
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return _setpoint;
+}
+
+// isActive
+bool SetpointProfile::isActive() const {
+	return (_phase != Phase::IDLE && _phase != Phase::DONE);
+}
+
+// getPhase
+SetpointProfile::Phase SetpointProfile::getPhase() const {
+	return _phase;
+}
+
+// getStepIndex
+size_t SetpointProfile::getStepIndex() const {
+	return _stepIndex;
+}
+
+// getSteps
+const std::vector<ProfileStep>& SetpointProfile::getSteps() const {
+	return _steps;
+}
+
+// getSetpoint
+f32 SetpointProfile::getSetpoint() const {
+	return _setpoint;
+}
+
+// getRampRate
+f32 SetpointProfile::getRampRate() const {
+
+	if ( _phase != Phase::RAMPING ) {
+		return 0.0f;
+	}
+
+	const ProfileStep& step = _steps[_stepIndex];
+	f32 rate = std::max( 0.0f, step._rampRate ) / 60.0f;
+	return (step._target >= _setpoint ? rate : -rate);
+}
+
+// getPhaseRemaining
+f32 SetpointProfile::getPhaseRemaining() const {
+
+	switch ( _phase ) {
+	case Phase::RAMPING: {
+		const ProfileStep& step = _steps[_stepIndex];
+		if ( step._rampRate <= 0.0f ) {
+			return 0.0f;
+		}
+		return (std::fabs( step._target - _setpoint ) / step._rampRate) * 60.0f;
+	}
+
+	case Phase::WAITING:
+		return -1.0f;
+
+	case Phase::SOAKING:
+		return std::max( 0.0f, _steps[_stepIndex]._soakDuration - _soakElapsed );
+
+	default:
+		return 0.0f;
+	}
+}
+
+// setTolerance
+void SetpointProfile::setTolerance( f32 tolerance ) {
+	_tolerance = tolerance;
+}
+
+// getTolerance
+f32 SetpointProfile::getTolerance() const {
+	return _tolerance;
+}
+
+// parse
+std::vector<ProfileStep> SetpointProfile::parse( const std::string& steps ) {
+
+	std::vector<ProfileStep> result;
+
+	if ( steps.empty() ) {
+		return result;
+	}
+
+	for ( const std::string& part : split( steps, "," )) {
+		std::vector<std::string> fields = split( part, ":" );
+		if ( fields.size() != 3 ) {
+			throw RollerException( "Illegal profile step (%s), expected target:rampRate:soakDuration", part.c_str() );
+		}
+
+		ProfileStep step;
+		step._target = Serialization::toF32( fields[0] );
+		step._rampRate = Serialization::toF32( fields[1] );
+		step._soakDuration = Serialization::toF32( fields[2] );
+		result.push_back( step );
+	}
+
+	return result;
+}
+
+// to_json
+void to_json(json& j, const SetpointProfile::Phase& phase) {
+	switch (phase) {
+		case SetpointProfile::Phase::IDLE:
+			j = "idle";
+			break;
+		case SetpointProfile::Phase::RAMPING:
+			j = "ramping";
+			break;
+		case SetpointProfile::Phase::WAITING:
+			j = "waiting";
+			break;
+		case SetpointProfile::Phase::SOAKING:
+			j = "soaking";
+			break;
+		case SetpointProfile::Phase::DONE:
+			j = "done";
+			break;
+	}
+}
+
+// to_json
+void to_json(json& j, const SetpointProfile& profile) {
+	j = json {
+		{"phase", profile.getPhase()},
+		{"step", profile.getStepIndex()},
+		{"numSteps", profile.getSteps().size()},
+		{"setpoint", profile.getSetpoint()},
+		{"phaseRemaining", profile.getPhaseRemaining()}
+	};
+}
@@ -0,0 +1,109 @@
+#include "smith_predictor.h"
+
+#include <cmath>
+
+// Constructor
+SmithPredictor::SmithPredictor( std::shared_ptr<PID> pid, f32 processGain, f32 timeConstant, f32 deadTime ) :
+				_pid(pid),
+				_processGain(processGain),
+				_timeConstant(timeConstant),
+				_deadTime(deadTime),
+				_appliedOutput(0),
+				_hasAppliedOutput(false),
+				_clock(0),
+				_modelOutput(0),
+				_correction(0) {
+	_history.push_back( std::make_pair( _clock, _modelOutput ));
+}
+
+// update
+f32 SmithPredictor::update( f32 input, f32 dt ) {
+
+	// the output that has been driving the process since the last update
+	f32 u = (_hasAppliedOutput ? _appliedOutput : _pid->getOutput());
+	_hasAppliedOutput = false;
+
+	// advance the undelayed model (exact first order step, stable for any dt)
+	if ( dt > 0.0f ) {
+		_clock += dt;
+
+		f32 target = _processGain * u;
+		if ( _timeConstant > 0.0f ) {
+			_modelOutput = target + ((_modelOutput - target) * std::exp( -dt / _timeConstant ));
+		} else {
+			_modelOutput = target;
+		}
+
+		_history.push_back( std::make_pair( _clock, _modelOutput ));
+	}
+
+	// drop history we no longer need; keep one entry at or before the delay horizon
+	f32 horizon = _clock - _deadTime;
+	while ( _history.size() > 1 && _history[1].first <= horizon ) {
+		_history.pop_front();
+	}
+
+	_correction = _modelOutput - getDelayedModelOutput();
+
+	return _pid->update( input + _correction, dt );
+}
+
+// setAppliedOutput
+void SmithPredictor::setAppliedOutput( f32 appliedOutput ) {
+	_appliedOutput = appliedOutput;
+	_hasAppliedOutput = true;
+	_pid->setAppliedOutput( appliedOutput );
+}
+
+// setModel
+void SmithPredictor::setModel( f32 processGain, f32 timeConstant, f32 deadTime ) {
+	_processGain = processGain;
+	_timeConstant = timeConstant;
+	_deadTime = deadTime;
+}
+
+// getProcessGain
+f32 SmithPredictor::getProcessGain() const {
+	return _processGain;
+}
+
+// getTimeConstant
+f32 SmithPredictor::getTimeConstant() const {
+	return _timeConstant;
+}
+
+// getDeadTime
+f32 SmithPredictor::getDeadTime() const {
+	return _deadTime;
+}
+
+// getCorrection
+f32 SmithPredictor::getCorrection() const {
+	return _correction;
+}
+
+// getPID
+std::shared_ptr<PID> SmithPredictor::getPID() const {
+	return _pid;
+}
+
+// getDelayedModelOutput
+f32 SmithPredictor::getDelayedModelOutput() const {
+
+	f32 horizon = _clock - _deadTime;
+
+	const std::pair<f32, f32>& oldest = _history.front();
+	if ( _history.size() == 1 || horizon <= oldest.first ) {
+		return oldest.second;
+	}
+
+	// interpolate between the entries straddling the horizon
+	const std::pair<f32, f32>& next = _history[1];
+	f32 span = next.first - oldest.first;
+	if ( span <= 0.0f ) {
+		return next.second;
+	}
+
+	f32 alpha = (horizon - oldest.first) / span;
+	return oldest.second + (alpha * (next.second - oldest.second));
+}
@@ -0,0 +1,127 @@
+#include "temperature_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define AB_ESTIMATOR_INITIAL_SLOPE_STD_DEV 0.1 // C / s
+
+// Constructor
+TemperatureEstimator::TemperatureEstimator( f32 measurementNoise, f32 processNoise ) :
+				_measurementNoise(measurementNoise),
+				_processNoise(processNoise) {
+	reset();
+}
+
+// reset
+void TemperatureEstimator::reset() {
+	_initialized = false;
+	_time = 0;
+	_x[0] = 0.0;
+	_x[1] = 0.0;
+	_p[0][0] = 0.0;
+	_p[0][1] = 0.0;
+	_p[1][0] = 0.0;
+	_p[1][1] = 0.0;
+}
+
+// isInitialized
+bool TemperatureEstimator::isInitialized() const {
+	return _initialized;
+}
+
+// update
+void TemperatureEstimator::update( f32 temp, i64 time ) {
+
+	f64 r = (f64)_measurementNoise * (f64)_measurementNoise;
+
+	if ( ! _initialized ) {
+		_initialized = true;
+		_time = time;
+		_x[0] = temp;
+		_x[1] = 0.0;
+		_p[0][0] = r;
+		_p[0][1] = 0.0;
+		_p[1][0] = 0.0;
+		_p[1][1] = AB_ESTIMATOR_INITIAL_SLOPE_STD_DEV * AB_ESTIMATOR_INITIAL_SLOPE_STD_DEV;
+		return;
+	}
+
+	if ( time <= _time ) {
+		return;
+	}
+
+	propagate( (f64)(time - _time) / 1000.0, _x, _p );
+	_time = time;
+
+	// measure temp only: H = [1, 0]
+	f64 s = _p[0][0] + r;
+	f64 k[2] = { _p[0][0] / s, _p[1][0] / s };
+	f64 innovation = (f64)temp - _x[0];
+
+	_x[0] += (k[0] * innovation);
+	_x[1] += (k[1] * innovation);
+
+	f64 p00 = _p[0][0];
+	f64 p01 = _p[0][1];
+	_p[0][0] -= (k[0] * p00);
+	_p[0][1] -= (k[0] * p01);
+	_p[1][0] -= (k[1] * p00);
+	_p[1][1] -= (k[1] * p01);
+}
+
+// predict
+TemperatureEstimate TemperatureEstimator::predict( i64 time ) const {
+
+	TemperatureEstimate estimate;
+	estimate._time = time;
+	estimate._sampleTime = _time;
+
+	f64 x[2] = { _x[0], _x[1] };
+	f64 p[2][2] = { { _p[0][0], _p[0][1] }, { _p[1][0], _p[1][1] } };
+	if ( time > _time ) {
+		propagate( (f64)(time - _time) / 1000.0, x, p );
+	}
+
+	estimate._temp = (f32)x[0];
+	estimate._slope = (f32)x[1];
+	estimate._stdDev = (f32)std::sqrt( std::max( 0.0, p[0][0] ));
+	return estimate;
+}
+
+// propagate
+void TemperatureEstimator::propagate( f64 dt, f64 x[2], f64 p[2][2] ) const {
+
+	// F = [1 dt; 0 1], Q = q * [dt^3/3 dt^2/2; dt^2/2 dt]
+	x[0] += (x[1] * dt);
+
+	f64 q = _processNoise;
+	f64 p00 = p[0][0] + (dt * (p[1][0] + p[0][1])) + (dt * dt * p[1][1]) + (q * dt * dt * dt / 3.0);
+	f64 p01 = p[0][1] + (dt * p[1][1]) + (q * dt * dt / 2.0);
+	f64 p10 = p[1][0] + (dt * p[1][1]) + (q * dt * dt / 2.0);
+	f64 p11 = p[1][1] + (q * dt);
+
+	p[0][0] = p00;
+	p[0][1] = p01;
+	p[1][0] = p10;
+	p[1][1] = p11;
+}
+
+// setMeasurementNoise
+void TemperatureEstimator::setMeasurementNoise( f32 measurementNoise ) {
+	_measurementNoise = measurementNoise;
+}
+
+// getMeasurementNoise
+f32 TemperatureEstimator::getMeasurementNoise() const {
+	return _measurementNoise;
+}
+
+// setProcessNoise
+void TemperatureEstimator::setProcessNoise( f32 processNoise ) {
+	_processNoise = processNoise;
+}
+
+// getProcessNoise
+f32 TemperatureEstimator::getProcessNoise() const {
+	return _processNoise;
+}
@@ -1,30 +1,63 @@
 #include "temperature_manager.h"
 
-#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
 #include "device_manager.h"
 
+#include <json.hpp>
+
 #include <roller/core/util.h>
 
 using namespace devman;
 using std::ofstream;
 using std::endl;
 using std::ios;
+using std::ifstream;
+using json = nlohmann::json;
+
+#define AB_PROBE_MIN_NOISE 0.03f // C, the estimator's measurement noise at full resolution
+#define AB_PROBE_MAX_RESOLUTION 12 // bits, where a 1 bit step is 0.0625 C
+#define AB_PROBE_WARM_UP_SAMPLES 5 // a probe is active until it has this many samples
+#define AB_PROBE_MISSED_DISCOVERIES 2 // a probe is removed once missing from this many discoveries in a row
+#define AB_EVENT_QUEUE_CAPACITY 256
+#define AB_PROBE_QUARANTINE_FAILURES 3 // failed reads in a row that quarantine a probe
+#define AB_PROBE_MIN_BACKOFF 5000 // ms, between reads of a quarantined probe, doubled per failure...
+#define AB_PROBE_MAX_BACKOFF 300000 // ms, ...up to this
+#define AB_VIRTUAL_PROBE_MANAGER "virtual" // the manager id of virtual probes
+#define AB_FUSION_MIN_VARIANCE 1.0e-6 // C^2, so a source with no uncertainty can't take all the weight
 
 
 // Constructor
 TemperatureManager::TemperatureManager() :
 				Thread( std::bind( &TemperatureManager::doRun, this )),
 				_dataLock(true),
-				_running(false),
+				_stopping(false),
+				_rescheduled(false),
+				_readTimeout(3000),
 				_updateFrequency(333),
 				_lastUpdate(0),
 				_updateProbeListFrequency(15000),
-				_lastUpdateProbeList(0),
+				_discoveryThread( std::bind( &TemperatureManager::doDiscovery, this )),
+				_events(AB_EVENT_QUEUE_CAPACITY),
+				_overflowPolicy(EventOverflowPolicy::DROP_OLDEST),
+				_eventDepth(0),
+				_maxEventDepth(0),
+				_postedEvents(0),
+				_deliveredEvents(0),
+				_droppedEvents(0),
+				_coalescedEvents(0),
+				_filteredEvents(0),
+				_dispatcherIdle(false),
+				_dispatching(false),
+				_dispatchThread( std::bind( &TemperatureManager::doDispatch, this )),
 				_eventLock(true) {
-	_lastUpdate = getTime() + 3000;
+	std::atomic_store( &_probeTable, shared_ptr<const ProbeTable>( new ProbeTable() ));
 }
 
 TemperatureManager::~TemperatureManager() {
@@ -35,12 +68,25 @@ TemperatureManager::~TemperatureManager() {
 
 // stop
 void TemperatureManager::stop() {
-	_running = false;
+	std::lock_guard<std::mutex> locker( _scheduleLock );
+	_stopping = true;
+	_scheduleCondition.notify_all();
+	_discoveryCondition.notify_all();
+}
+
+// reschedule
+void TemperatureManager::reschedule() {
+	std::lock_guard<std::mutex> locker( _scheduleLock );
+	_rescheduled = true;
+	_scheduleCondition.notify_all();
 }
 
 // setUpdateFrequency
 void TemperatureManager::setUpdateFrequency( i32 updateFrequency ) {
+	std::lock_guard<std::mutex> locker( _scheduleLock );
 	_updateFrequency = updateFrequency;
+	_rescheduled = true;
+	_scheduleCondition.notify_all();
 };
 
 //  getUpdateFrequency
@@ -50,38 +96,322 @@ i32 TemperatureManager::getUpdateFrequency() const {
 
 // listProbes
 list<StringId> TemperatureManager::listProbes() {
-	list<StringId> probes;
+	shared_ptr<const vector<StringId>> probes = getProbes();
+	return list<StringId>( probes->begin(), probes->end() );
+}
+
+// getProbes
+shared_ptr<const vector<StringId>> TemperatureManager::getProbes() const {
+	shared_ptr<const ProbeTable> table = std::atomic_load( &_probeTable );
+	return shared_ptr<const vector<StringId>>( table, &table->_sensorIds );
+}
+
+// getProbeStats
+ProbeStats TemperatureManager::getProbeStats( const StringId& sensorId ) const {
+	return getProbeStats( getProbeHandle( sensorId ));
+}
+
+// getProbeStats
+ProbeStats TemperatureManager::getProbeStats( ProbeHandle handle ) const {
+
+	shared_ptr<const ProbeTable> table = std::atomic_load( &_probeTable );
+	if ( handle < 0 || handle >= (ProbeHandle)table->_slots.size() ) {
+		throw RollerException( "No such probe handle: %d", handle );
+	}
+
+	return table->_slots[handle]->load();
+}
+
+// getProbeHandle
+ProbeHandle TemperatureManager::getProbeHandle( const StringId& sensorId ) const {
+
+	shared_ptr<const ProbeTable> table = std::atomic_load( &_probeTable );
+	auto itr = table->_handles.find( sensorId );
+	if ( itr == table->_handles.end() ) {
+		throw RollerException( "No such probe stats: %s", sensorId.getString().c_str() );
+	}
+
+	return itr->second;
+}
 
-	// Log::i( "TemperatureManager::listProbes()" );
+// getEstimate
+TemperatureEstimate TemperatureManager::getEstimate( const StringId& sensorId, i64 time ) const {
+	return getEstimate( getProbeHandle( sensorId ), time );
+}
+
+// getEstimate
+TemperatureEstimate TemperatureManager::getEstimate( ProbeHandle handle, i64 time ) const {
 
 	_dataLock.lock();
-	for ( auto entry : _knownProbes ) {
-		probes.push_back( entry.second );
+	if ( handle < 0 || handle >= (ProbeHandle)_probes.size() || ! _probes[handle]._estimator.isInitialized() ) {
+		_dataLock.unlock();
+		throw RollerException( "No temperature estimate for probe handle: %d", handle );
 	}
+
+	TemperatureEstimate estimate = _probes[handle]._estimator.predict( time );
 	_dataLock.unlock();
 
-	return probes;
+	return estimate;
 }
 
-// getProbeStats
-const ProbeStats& TemperatureManager::getProbeStats( const StringId& sensorId ) const {
+// setBulkReader
+void TemperatureManager::setBulkReader( const StringId& managerId, const shared_ptr<BulkTemperatureReader>& reader ) {
+	_dataLock.lock();
+	if ( reader ) {
+		_bulkReaders[managerId] = reader;
+	} else {
+		_bulkReaders.erase( managerId );
+	}
+
+	auto bus = _busIndices.find( managerId );
+	if ( bus != _busIndices.end() ) {
+		_buses[bus->second]->setBulkReader( reader );
+	}
+
+	for ( auto& entry : _probes ) {
+		if ( entry._settings._managerId == managerId ) {
+			entry._bulkReader = reader;
+			entry._stats._resolution = -1; // apply it again
+		}
+	}
+	_dataLock.unlock();
+}
+
+// setDefaultPollPolicy
+void TemperatureManager::setDefaultPollPolicy( const ProbePollPolicy& policy ) {
+	_dataLock.lock();
+	_defaultPollPolicy = policy;
+	for ( auto& entry : _probes ) {
+		if ( _pollPolicies.find( entry._settings._id ) == _pollPolicies.end() ) {
+			entry._pollPolicy = policy;
+			entry._nextRead = 0;
+		}
+	}
+	_dataLock.unlock();
+
+	reschedule();
+}
 
+// setPollPolicy
+void TemperatureManager::setPollPolicy( const StringId& sensorId, const ProbePollPolicy& policy ) {
 	_dataLock.lock();
-	auto itr = _probeStats.find( sensorId );
-	if ( itr != _probeStats.end() ) {
+	_pollPolicies[sensorId] = policy;
+
+	ProbeHandle handle = findProbe( sensorId );
+	if ( handle != AB_INVALID_PROBE_HANDLE ) {
+		_probes[handle]._pollPolicy = policy;
+		_probes[handle]._nextRead = 0;
+	}
+	_dataLock.unlock();
+
+	reschedule();
+}
+
+// clearPollPolicy
+void TemperatureManager::clearPollPolicy( const StringId& sensorId ) {
+	_dataLock.lock();
+	_pollPolicies.erase( sensorId );
+
+	ProbeHandle handle = findProbe( sensorId );
+	if ( handle != AB_INVALID_PROBE_HANDLE ) {
+		_probes[handle]._pollPolicy = _defaultPollPolicy;
+		_probes[handle]._nextRead = 0;
+	}
+	_dataLock.unlock();
+
+	reschedule();
+}
+
+// getPollPolicy
+ProbePollPolicy TemperatureManager::getPollPolicy( const StringId& sensorId ) const {
+	_dataLock.lock();
+	auto itr = _pollPolicies.find( sensorId );
+	ProbePollPolicy policy = (itr == _pollPolicies.end() ? _defaultPollPolicy : itr->second);
+	_dataLock.unlock();
+
+	return policy;
+}
+
+// setDemandedProbes
+void TemperatureManager::setDemandedProbes( const set<StringId>& sensorIds ) {
+	_dataLock.lock();
+	if ( sensorIds == _demandedProbes ) {
 		_dataLock.unlock();
-		return itr->second;
-	} else {
+		return;
+	}
+
+	_demandedProbes = sensorIds;
+	updateDemand();
+	_dataLock.unlock();
+
+	reschedule();
+}
+
+// setVirtualProbe
+void TemperatureManager::setVirtualProbe( const StringId& sensorId, const VirtualProbeSettings& settings ) {
+
+	if ( settings._sources.empty() ) {
+		throw RollerException( "Virtual probe %s needs at least one source", sensorId.getString().c_str() );
+	}
+
+	vector<pair<ProbeSettings, ProbeStats>> added;
+
+	_dataLock.lock();
+	ProbeHandle handle = findProbe( sensorId );
+	if ( handle != AB_INVALID_PROBE_HANDLE && ! _probes[handle]._virtual ) {
 		_dataLock.unlock();
-		throw RollerException( "No such probe stats: %s", sensorId.getString().c_str() );
+		throw RollerException( "Probe %s is a physical probe", sensorId.getString().c_str() );
+	}
+
+	if ( handle == AB_INVALID_PROBE_HANDLE ) {
+		handle = addProbe( StringId::intern( AB_VIRTUAL_PROBE_MANAGER ), sensorId, getTime() );
+		_probes[handle]._virtual = true;
+		_probes[handle]._present = false;
+	}
+
+	ProbeEntry& entry = _probes[handle];
+	entry._fusion = settings;
+	entry._stats._resolution = 0;
+
+	if ( ! entry._present ) {
+		entry._present = true;
+		added.push_back( std::make_pair( entry._settings, entry._stats ));
+	}
+
+	linkVirtualProbes();
+	updateDemand();
+	publishProbeTable();
+	_dataLock.unlock();
+
+	for ( auto& probe : added ) {
+		fireProbeAddedEvent( probe.first, probe.second );
+	}
+}
+
+// removeVirtualProbe
+void TemperatureManager::removeVirtualProbe( const StringId& sensorId ) {
+
+	_dataLock.lock();
+	ProbeHandle handle = findProbe( sensorId );
+	if ( handle == AB_INVALID_PROBE_HANDLE || ! _probes[handle]._virtual || ! _probes[handle]._present ) {
+		_dataLock.unlock();
+		return;
+	}
+
+	ProbeEntry& entry = _probes[handle];
+	entry._present = false;
+	ProbeSettings settings = entry._settings;
+	ProbeStats stats = entry._stats;
+
+	linkVirtualProbes();
+	updateDemand();
+	publishProbeTable();
+	_dataLock.unlock();
+
+	fireProbeRemovedEvent( settings, stats );
+}
+
+// getVirtualProbes
+map<StringId, VirtualProbeSettings> TemperatureManager::getVirtualProbes() const {
+	map<StringId, VirtualProbeSettings> probes;
+
+	_dataLock.lock();
+	for ( auto& entry : _probes ) {
+		if ( entry._virtual && entry._present ) {
+			probes[entry._settings._id] = entry._fusion;
+		}
+	}
+	_dataLock.unlock();
+
+	return probes;
+}
+
+// setReadTimeout
+void TemperatureManager::setReadTimeout( i32 readTimeout ) {
+	_dataLock.lock();
+	_readTimeout = readTimeout;
+	for ( auto& bus : _buses ) {
+		bus->setReadTimeout( readTimeout );
+	}
+	_dataLock.unlock();
+}
+
+// getBusStats
+map<StringId, BusStats> TemperatureManager::getBusStats() const {
+	map<StringId, BusStats> stats;
+
+	_dataLock.lock();
+	for ( auto& entry : _busIndices ) {
+		stats[entry.first] = _buses[entry.second]->getStats();
+	}
+	_dataLock.unlock();
+
+	return stats;
+}
+
+// setSampleFilterSettings
+void TemperatureManager::setSampleFilterSettings( const SampleFilterSettings& settings ) {
+	_dataLock.lock();
+	_sampleFilterSettings = settings;
+	for ( auto& entry : _probes ) {
+		entry._filter.setSettings( settings );
 	}
+	_dataLock.unlock();
+}
+
+// getSampleFilterSettings
+SampleFilterSettings TemperatureManager::getSampleFilterSettings() {
+	_dataLock.lock();
+	SampleFilterSettings settings = _sampleFilterSettings;
+	_dataLock.unlock();
+	return settings;
+}
+
+// setEventOverflowPolicy
+void TemperatureManager::setEventOverflowPolicy( EventOverflowPolicy policy ) {
+	_overflowPolicy = policy;
+}
+
+// getEventOverflowPolicy
+EventOverflowPolicy TemperatureManager::getEventOverflowPolicy() const {
+	return _overflowPolicy;
+}
+
+// getEventQueueStats
+EventQueueStats TemperatureManager::getEventQueueStats() const {
+	EventQueueStats stats;
+	stats._capacity = (i32)_events.getCapacity();
+	stats._depth = std::max( (i64)0, _eventDepth.load() );
+	stats._maxDepth = _maxEventDepth;
+	stats._posted = _postedEvents;
+	stats._delivered = _deliveredEvents;
+	stats._dropped = _droppedEvents;
+	stats._coalesced = _coalescedEvents;
+	stats._filtered = _filteredEvents;
+	return stats;
+}
+
+// setInventoryPath
+void TemperatureManager::setInventoryPath( const string& path ) {
+	_inventoryPath = path;
 }
 
 // addStatsListener
 Key TemperatureManager::addStatsListener( const ProbeStatsListener& listener ) {
+	return addStatsListener( listener, StatsSubscription() );
+}
+
+// addStatsListener
+Key TemperatureManager::addStatsListener( const ProbeStatsListener& listener, const StatsSubscription& subscription ) {
+	shared_ptr<StatsSubscriber> subscriber = std::make_shared<StatsSubscriber>();
+	subscriber->_listener = listener;
+	subscriber->_subscription = subscription;
+
 	_eventLock.lock();
-	Key key = _probeStatsListeners.add( listener );
+	Key key = _probeStatsListeners.add( subscriber );
 	_eventLock.unlock();
+
+	updateSubscribedProbes();
 	return key;
 }
 
@@ -90,6 +420,25 @@ void TemperatureManager::removeStatsListener( const Key& key ) {
 	_eventLock.lock();
 	_probeStatsListeners.remove( key );
 	_eventLock.unlock();
+
+	updateSubscribedProbes();
+}
+
+// updateSubscribedProbes
+void TemperatureManager::updateSubscribedProbes() {
+
+	// the event lock is always taken before the data lock
+	_eventLock.lock();
+	set<StringId> probes;
+	for ( auto subscriber : _probeStatsListeners ) {
+		probes.insert( subscriber->_subscription._probes.begin(), subscriber->_subscription._probes.end() );
+	}
+
+	_dataLock.lock();
+	_subscribedProbes = probes;
+	updateDemand();
+	_dataLock.unlock();
+	_eventLock.unlock();
 }
 
 // addNewProbeListener
@@ -107,45 +456,227 @@ void TemperatureManager::removeNewProbeListener( const Key& key ) {
 	_eventLock.unlock();
 }
 
+// addRemovedProbeListener
+Key TemperatureManager::addRemovedProbeListener( const RemovedProbeListener& listener ) {
+	_eventLock.lock();
+	Key key = _removedProbeListeners.add( listener );
+	_eventLock.unlock();
+	return key;
+}
+
+// removeRemovedProbeListener
+void TemperatureManager::removeRemovedProbeListener( const Key& key ) {
+	_eventLock.lock();
+	_removedProbeListeners.remove( key );
+	_eventLock.unlock();
+}
+
+// addHealthListener
+Key TemperatureManager::addHealthListener( const ProbeHealthListener& listener ) {
+	_eventLock.lock();
+	Key key = _healthListeners.add( listener );
+	_eventLock.unlock();
+	return key;
+}
+
+// removeHealthListener
+void TemperatureManager::removeHealthListener( const Key& key ) {
+	_eventLock.lock();
+	_healthListeners.remove( key );
+	_eventLock.unlock();
+}
+
 // doRun
 void TemperatureManager::doRun() {
 
-	_running = true;
+	// stopped before we got going
+	{
+		std::lock_guard<std::mutex> locker( _scheduleLock );
+		if ( _stopping ) {
+			return;
+		}
+	}
 
-	while ( _running ) {
+	_dispatching = true;
+	_dispatchThread.run();
 
-		i64 now = getTime();
-		i64 elapsed = now - _lastUpdate;
+	// start on the probes we knew last time, while discovery catches up
+	loadInventory();
+	_discoveryThread.run();
 
-		if ( elapsed < _updateFrequency ) {
-			// sleep for 3 ms (don't want to sleep too long, otherwise we might
-			// block when we want to exit the app)
-			usleep( 3000 );
-			continue;
-		}
+	while ( true ) {
 
-		// update probe list if appropriate
-		if ( now - _lastUpdateProbeList > _updateProbeListFrequency ) {
-			try {
-				updateProbeList();
-			} catch ( const exception& e ) {
-				Log::w( "Exception while trying to get probe list, will try again: %s", e.what() );
-				// TODO: detect multiple failures in a row
-				continue;
-			} catch ( ... ) {
-				Log::w( "Unrecognized exception while trying to get probe list, will try again" );
-				// TODO: detect multiple failures in a row
+		// sleep until the next probe is due, planning again on any change
+		i64 deadline = getNextDeadline();
+		{
+			std::unique_lock<std::mutex> locker( _scheduleLock );
+			if ( _stopping ) {
+				break;
+			}
+
+			i64 wait = deadline - getTime();
+			if ( _rescheduled || wait > 0 ) {
+				if ( ! _rescheduled ) {
+					_scheduleCondition.wait_for( locker, std::chrono::milliseconds( wait ));
+				}
+				_rescheduled = false;
 				continue;
 			}
-			_lastUpdateProbeList = now;
 		}
 
+		i64 now = getTime();
+
 		// update temperatures
-		updateTemperatures();
+		updateTemperatures( now );
 		_lastUpdate = now;
 
 		dumpTempData();
 	}
+
+	_discoveryThread.join();
+
+	// destroy the buses outside the lock, their workers may be waiting on it
+	vector<unique_ptr<ProbeBus>> buses;
+	_dataLock.lock();
+	buses.swap( _buses );
+	_busIndices.clear();
+	_dataLock.unlock();
+
+	buses.clear();
+
+	// nothing posts any more; drop what is left rather than wait on slow listeners
+	{
+		std::lock_guard<std::mutex> locker( _dispatchLock );
+		_dispatching = false;
+		_dispatchCondition.notify_all();
+	}
+	_dispatchThread.join();
+}
+
+// doDispatch
+void TemperatureManager::doDispatch() {
+
+	while ( true ) {
+		StatsEvent event;
+		while ( _events.pop( event )) {
+			_eventDepth--;
+
+			if ( ! _dispatching ) {
+				discardStatsEvent( event );
+				continue;
+			}
+
+			if ( event._mailbox ) {
+				std::lock_guard<std::mutex> locker( event._mailbox->_lock );
+				event._before = event._mailbox->_before;
+				event._after = event._mailbox->_after;
+				event._mailbox->_queued = false;
+			}
+
+			fireProbeStatsChangedEvent( event._before, event._after );
+			if ( event._after._health != event._before._health ) {
+				fireProbeHealthChangedEvent( event._after, event._before._health );
+			}
+			_deliveredEvents++;
+		}
+
+		// producers only take the lock to wake us once we say we are idle
+		std::unique_lock<std::mutex> locker( _dispatchLock );
+		_dispatcherIdle = true;
+		_dispatchCondition.wait( locker, [this]() {
+			return (_eventDepth > 0 || ! _dispatching);
+		});
+		_dispatcherIdle = false;
+
+		if ( ! _dispatching && _eventDepth <= 0 ) {
+			break;
+		}
+	}
+}
+
+// postStatsEvent
+void TemperatureManager::postStatsEvent( ProbeMailbox* mailbox, const ProbeStats& before, const ProbeStats& after ) {
+
+	_postedEvents++;
+
+	StatsEvent event;
+	if ( _overflowPolicy == EventOverflowPolicy::COALESCE ) {
+		{
+			// a pending event keeps its "before" and takes the new "after"
+			std::lock_guard<std::mutex> locker( mailbox->_lock );
+			if ( mailbox->_queued ) {
+				mailbox->_after = after;
+				_coalescedEvents++;
+				return;
+			}
+			mailbox->_before = before;
+			mailbox->_after = after;
+			mailbox->_queued = true;
+		}
+
+		event._mailbox = mailbox;
+		if ( ! _events.push( event )) {
+			std::lock_guard<std::mutex> locker( mailbox->_lock );
+			mailbox->_queued = false;
+			_droppedEvents++;
+			return;
+		}
+
+	} else {
+		event._before = before;
+		event._after = after;
+		while ( ! _events.push( event )) {
+			StatsEvent oldest;
+			if ( _events.pop( oldest )) {
+				_eventDepth--;
+				discardStatsEvent( oldest );
+			}
+		}
+	}
+
+	i64 depth = ++_eventDepth;
+	i64 maxDepth = _maxEventDepth;
+	while ( depth > maxDepth && ! _maxEventDepth.compare_exchange_weak( maxDepth, depth )) {
+	}
+
+	if ( _dispatcherIdle ) {
+		std::lock_guard<std::mutex> locker( _dispatchLock );
+		_dispatchCondition.notify_all();
+	}
+}
+
+// discardStatsEvent
+void TemperatureManager::discardStatsEvent( const StatsEvent& event ) {
+	if ( event._mailbox ) {
+		std::lock_guard<std::mutex> locker( event._mailbox->_lock );
+		event._mailbox->_queued = false;
+	}
+	_droppedEvents++;
+}
+
+// doDiscovery
+void TemperatureManager::doDiscovery() {
+
+	while ( true ) {
+		try {
+			updateProbeList();
+		} catch ( const exception& e ) {
+			Log::w( "Exception while trying to get probe list, will try again: %s", e.what() );
+			// TODO: detect multiple failures in a row
+		} catch ( ... ) {
+			Log::w( "Unrecognized exception while trying to get probe list, will try again" );
+			// TODO: detect multiple failures in a row
+		}
+
+		std::unique_lock<std::mutex> locker( _scheduleLock );
+		_discoveryCondition.wait_for( locker, std::chrono::milliseconds( _updateProbeListFrequency ), [this]() {
+			return _stopping;
+		});
+
+		if ( _stopping ) {
+			break;
+		}
+	}
 }
 
 // updateProbeList
@@ -156,116 +687,714 @@ void TemperatureManager::updateProbeList() {
 	auto probes = DeviceManager::listTemperatureSensors();
 	i64 now = getTime();
 
-	set<pair<StringId, StringId>> newProbes;
+	vector<pair<ProbeSettings, ProbeStats>> added;
+	vector<pair<ProbeSettings, ProbeStats>> removed;
+	bool moved = false;
+
+	_dataLock.lock();
 
-	for ( auto entry : probes ) {
-		if ( _knownProbes.find( entry ) == _knownProbes.end() ) {
-			newProbes.insert( entry );
+	set<StringId> seen;
+	for ( auto probe : probes ) {
+		StringId managerId = probe.first;
+		StringId sensorId = probe.second;
+		seen.insert( sensorId );
+
+		ProbeHandle handle = findProbe( sensorId );
+		if ( handle == AB_INVALID_PROBE_HANDLE ) {
+			handle = addProbe( managerId, sensorId, now );
+			resolveSensor( _probes[handle] );
+			added.push_back( std::make_pair( _probes[handle]._settings, _probes[handle]._stats ));
+			continue;
+		}
+
+		ProbeEntry& entry = _probes[handle];
+		if ( entry._virtual ) {
+			Log::w( "Probe %s has the id of a virtual probe (ignoring)", sensorId.getString().c_str() );
+			continue;
 		}
+		entry._missedDiscoveries = 0;
+
+		if ( entry._settings._managerId != managerId ) {
+			entry._settings._managerId = managerId;
+			entry._sensor.reset();
+			moved = true;
+		}
+
+		if ( ! entry._present ) {
+			entry._present = true;
+			entry._nextRead = 0;
+			entry._failedReads = 0;
+			entry._backoff = 0;
+			entry._stats._health = ProbeHealth::HEALTHY;
+			added.push_back( std::make_pair( entry._settings, entry._stats ));
+		}
+
+		if ( ! entry._sensor ) {
+			resolveSensor( entry );
+		}
+	}
+
+	// a probe has to go missing twice before it counts as gone
+	for ( auto& entry : _probes ) {
+		if ( ! entry._present || entry._virtual || seen.find( entry._settings._id ) != seen.end() ) {
+			continue;
+		}
+
+		entry._missedDiscoveries++;
+		if ( entry._missedDiscoveries >= AB_PROBE_MISSED_DISCOVERIES ) {
+			entry._present = false;
+			entry._sensor.reset();
+			removed.push_back( std::make_pair( entry._settings, entry._stats ));
+		}
+	}
+
+	bool changed = (! added.empty() || ! removed.empty() || moved);
+	if ( changed || _buses.empty() ) {
+		updateBuses();
+	}
+
+	if ( changed ) {
+		publishProbeTable();
+	}
+	_dataLock.unlock();
+
+	if ( ! changed ) {
+		return;
+	}
+
+	saveInventory();
+	reschedule();
+
+	for ( auto& probe : removed ) {
+		fireProbeRemovedEvent( probe.first, probe.second );
+	}
+
+	for ( auto& probe : added ) {
+		fireProbeAddedEvent( probe.first, probe.second );
+	}
+}
+
+// addProbe
+ProbeHandle TemperatureManager::addProbe( const StringId& managerId, const StringId& sensorId, i64 now ) {
+
+	ProbeHandle handle = (ProbeHandle)_probes.size();
+	_probes.emplace_back();
+	_probeHandles[sensorId] = handle;
+
+	ProbeEntry& entry = _probes.back();
+
+	// const ProbeSettings& settings = g_prefManager.primeProbeSettings( sensorId, entry.first );
+	entry._settings = {
+			sensorId,
+			managerId,
+			sensorId.getString(),
+			true,
+			true };
+
+	// TODO: check stats (from database, etc.)
+	entry._stats = {
+			sensorId,
+			handle,
+			-1,
+			-1,
+			now,
+			now, 
+			0,
+			0,
+			0,
+			0,
+			-1,
+			true,
+			ProbeHealth::HEALTHY,
+			ProbePriority::NORMAL,
+			0 };
+
+	entry._slot.reset( new SampleSlot( sensorId, handle ));
+	entry._slot->store( entry._stats );
+	entry._mailbox.reset( new ProbeMailbox() );
+	entry._filter.setSettings( _sampleFilterSettings );
+
+	auto reader = _bulkReaders.find( managerId );
+	if ( reader != _bulkReaders.end() ) {
+		entry._bulkReader = reader->second;
+	}
+
+	auto policy = _pollPolicies.find( sensorId );
+	entry._pollPolicy = (policy == _pollPolicies.end() ? _defaultPollPolicy : policy->second);
+	entry._demanded = (_demandedProbes.find( sensorId ) != _demandedProbes.end());
+	entry._nextRead = 0;
+	entry._bus = 0;
+	entry._present = true;
+	entry._missedDiscoveries = 0;
+	entry._failedReads = 0;
+	entry._backoff = 0;
+	entry._virtual = false;
+	entry._lastFusionError = 0;
+
+	linkVirtualProbes();
+	updateDemand();
+
+	return handle;
+}
+
+// resolveSensor
+bool TemperatureManager::resolveSensor( ProbeEntry& entry ) {
+	try {
+		entry._sensor = DeviceManager::getTemperatureSensor( entry._settings._managerId, entry._settings._id );
+		return true;
+	} catch ( const exception& e ) {
+		Log::w( "Failed to resolve probe %s (will try again): %s", entry._settings._id.getString().c_str(), e.what() );
+	} catch ( ... ) {
+		Log::w( "Failed to resolve probe %s (will try again)", entry._settings._id.getString().c_str() );
+	}
+	return false;
+}
+
+// loadInventory
+void TemperatureManager::loadInventory() {
+
+	if ( _inventoryPath.empty() ) {
+		return;
+	}
+
+	json inventory;
+	try {
+		ifstream in( _inventoryPath );
+		if ( ! in.good() ) {
+			return;
+		}
+		in >> inventory;
+	} catch ( const exception& e ) {
+		Log::w( "Ignoring unreadable probe inventory %s: %s", _inventoryPath.c_str(), e.what() );
+		return;
 	}
 
-	// lock and copy new probes to list and create buffers
+	i64 now = getTime();
+	vector<pair<ProbeSettings, ProbeStats>> added;
+
 	_dataLock.lock();
-	for ( auto entry : newProbes ) {
-		_knownProbes.insert( entry );
+	try {
+		for ( auto& probe : inventory.at( "probes" )) {
+			StringId managerId = StringId::intern( probe.at( "manager" ).get<string>() );
+			StringId sensorId = StringId::intern( probe.at( "id" ).get<string>() );
+			if ( findProbe( sensorId ) != AB_INVALID_PROBE_HANDLE ) {
+				continue;
+			}
+
+			// only probes devman still knows; discovery will find the rest
+			shared_ptr<TemperatureSensor> sensor;
+			try {
+				sensor = DeviceManager::getTemperatureSensor( managerId, sensorId );
+			} catch ( ... ) {
+			}
+			if ( ! sensor ) {
+				continue;
+			}
 
-		StringId sensorId = entry.second;
+			ProbeHandle handle = addProbe( managerId, sensorId, now );
+			_probes[handle]._sensor = sensor;
+			added.push_back( std::make_pair( _probes[handle]._settings, _probes[handle]._stats ));
+		}
+	} catch ( const exception& e ) {
+		Log::w( "Ignoring malformed probe inventory %s: %s", _inventoryPath.c_str(), e.what() );
+	}
 
-		// TODO: check stats (from database, etc.)
-		_probeStats[sensorId] = {
-				sensorId,
-				-1,
-				now,
-				now, 
-				0,
-				0 };
+	if ( ! added.empty() ) {
+		updateBuses();
+		publishProbeTable();
+	}
+	_dataLock.unlock();
 
-		// const ProbeSettings& settings = g_prefManager.primeProbeSettings( sensorId, entry.first );
+	Log::i( "Loaded %d probes from inventory %s", (i32)added.size(), _inventoryPath.c_str() );
 
-		// fireProbeAddedEvent( settings, stats );
+	for ( auto& probe : added ) {
+		fireProbeAddedEvent( probe.first, probe.second );
+	}
+}
+
+// saveInventory
+void TemperatureManager::saveInventory() {
 
+	if ( _inventoryPath.empty() ) {
+		return;
+	}
+
+	json probes = json::array();
+	_dataLock.lock();
+	for ( auto& entry : _probes ) {
+		if ( entry._present && ! entry._virtual ) {
+			probes.push_back( {
+				{"manager", entry._settings._managerId.getString()},
+				{"id", entry._settings._id.getString()}
+			});
+		}
 	}
 	_dataLock.unlock();
 
-	// TODO: detect probes removed?
+	// write then rename, so a crash never leaves half a file
+	string tempPath = _inventoryPath + ".tmp";
+	ofstream out( tempPath, ios::trunc | ios::out );
+	out << json { {"probes", probes} }.dump( 4 ) << endl;
+	out.close();
+
+	if ( out.fail() || std::rename( tempPath.c_str(), _inventoryPath.c_str() ) != 0 ) {
+		Log::w( "Failed to save probe inventory to %s", _inventoryPath.c_str() );
+	}
+}
+
+// updateBuses
+void TemperatureManager::updateBuses() {
+
+	map<StringId, vector<StringId>> probesByManager;
+	for ( auto& entry : _probes ) {
+		if ( entry._present && ! entry._virtual ) {
+			probesByManager[entry._settings._managerId].push_back( entry._settings._id );
+		}
+	}
+
+	for ( auto probes : probesByManager ) {
+		auto itr = _busIndices.find( probes.first );
+		if ( itr == _busIndices.end() ) {
+			Log::i( "Starting probe bus %s", probes.first.getString().c_str() );
+
+			unique_ptr<ProbeBus> bus( new ProbeBus( probes.first, std::bind(
+					&TemperatureManager::recordReading,
+					this,
+					std::placeholders::_1,
+					std::placeholders::_2,
+					std::placeholders::_3,
+					std::placeholders::_4,
+					std::placeholders::_5,
+					std::placeholders::_6 )));
+			bus->setReadTimeout( _readTimeout );
+
+			auto reader = _bulkReaders.find( probes.first );
+			if ( reader != _bulkReaders.end() ) {
+				bus->setBulkReader( reader->second );
+			}
+
+			itr = _busIndices.insert( std::make_pair( probes.first, _buses.size() )).first;
+			_buses.push_back( std::move( bus ));
+		}
+
+		_buses[itr->second]->setProbes( probes.second );
+	}
+
+	for ( auto& entry : _probes ) {
+		if ( entry._present && ! entry._virtual ) {
+			entry._bus = _busIndices[entry._settings._managerId];
+		}
+	}
+}
+
+// getNextDeadline
+i64 TemperatureManager::getNextDeadline() {
+
+	// nothing to do until a probe turns up
+	i64 deadline = getTime() + _updateProbeListFrequency;
+
+	_dataLock.lock();
+	for ( auto& entry : _probes ) {
+		if ( entry._present && ! entry._virtual ) {
+			deadline = std::min( deadline, entry._nextRead );
+		}
+	}
+	_dataLock.unlock();
+
+	// never sweep more often than the update frequency
+	return std::max( deadline, _lastUpdate + _updateFrequency );
 }
 
 // updateTemperatures
-void TemperatureManager::updateTemperatures() {
+void TemperatureManager::updateTemperatures( i64 now ) {
 	// Log::i( "TemperatureManager::updateTemperatures()" );
 
-	for ( auto entry : _knownProbes ) {
+	_dataLock.lock();
 
-		// TODO: handle error
+	vector<ProbeEntry*> due;
+	for ( auto& entry : _probes ) {
+		if ( ! entry._present || entry._virtual || entry._nextRead > now || entry._bus >= _buses.size() ) {
+			continue;
+		}
 
-		StringId sensorId = entry.second;
-		auto sensor = DeviceManager::getTemperatureSensor( entry.first, entry.second );
+		scheduleProbe( entry, now );
+		entry._slot->store( entry._stats );
+		due.push_back( &entry );
+	}
 
-		i64 time = 0;
-		i32 temp = 0;
+	// each bus reads its most important probes first
+	std::stable_sort( due.begin(), due.end(), []( const ProbeEntry* a, const ProbeEntry* b ) {
+		return (a->_stats._priority < b->_stats._priority);
+	});
+
+	vector<vector<BusProbe>> dueProbes( _buses.size() );
+	for ( ProbeEntry* entry : due ) {
+		dueProbes[entry->_bus].push_back( {
+				entry->_stats._handle,
+				entry->_settings._id,
+				entry->_sensor,
+				entry->_stats._health == ProbeHealth::QUARANTINED } );
+	}
 
-		_dataLock.lock();
-		auto itr = _probeStats.find( sensorId );
-		if ( itr == _probeStats.end() ) {
-			_dataLock.unlock();
-			Log::w( "Invalid probe in probes list (ignoring): %s", sensorId.getString().c_str() );
+	for ( size_t i = 0; i < _buses.size(); i++ ) {
+		if ( dueProbes[i].empty() ) {
 			continue;
 		}
-		ProbeStats& stats = itr->second;
-		ProbeStats oldStats = stats;
+
+		// a bus still busy with its last sweep leaves its probes due
+		if ( _buses[i]->requestSweep( dueProbes[i] )) {
+			for ( auto& probe : dueProbes[i] ) {
+				ProbeEntry& entry = _probes[probe._handle];
+				entry._nextRead = now + entry._stats._pollInterval;
+			}
+		}
+	}
+
+	_dataLock.unlock();
+}
+
+// scheduleProbe
+void TemperatureManager::scheduleProbe( ProbeEntry& entry, i64 now ) {
+
+	const ProbePollPolicy& pollPolicy = entry._pollPolicy;
+	ProbeStats& stats = entry._stats;
+
+	// it takes a few samples before the slope means anything
+	bool active = true;
+	if ( ! entry._demanded && stats._numSuccess >= AB_PROBE_WARM_UP_SAMPLES && entry._estimator.isInitialized() ) {
+		active = (std::fabs( entry._estimator.predict( now )._slope ) >= pollPolicy._stableSlope);
+	}
+
+	stats._active = active;
+	stats._pollInterval = (active ? pollPolicy._activeInterval : pollPolicy._idleInterval);
+	if ( stats._health == ProbeHealth::QUARANTINED ) {
+		stats._pollInterval = std::max( stats._pollInterval, entry._backoff );
+	}
+
+	// only bulk readers can change the resolution
+	i32 resolution = (! entry._bulkReader ? 0 : (active ? pollPolicy._activeResolution : pollPolicy._idleResolution));
+	if ( resolution == stats._resolution ) {
+		return;
+	}
+
+	stats._resolution = resolution;
+	if ( resolution > 0 ) {
+		entry._bulkReader->setResolution( stats._id, resolution );
+	}
+
+	// coarser samples are noisier: a step of q has a quantization noise of q / sqrt(12)
+	f32 noise = AB_PROBE_MIN_NOISE;
+	if ( resolution > 0 && resolution < AB_PROBE_MAX_RESOLUTION ) {
+		f32 step = 0.0625f * (f32)(1 << (AB_PROBE_MAX_RESOLUTION - resolution));
+		noise = std::max( noise, step / std::sqrt( 12.0f ));
+	}
+	entry._estimator.setMeasurementNoise( noise );
+}
+
+// findProbe
+ProbeHandle TemperatureManager::findProbe( const StringId& sensorId ) const {
+	auto itr = _probeHandles.find( sensorId );
+	return (itr == _probeHandles.end() ? AB_INVALID_PROBE_HANDLE : itr->second);
+}
+
+// recordReading
+void TemperatureManager::recordReading( ProbeHandle handle, bool success, i32 temp, i64 time, i64 issued, const string& error ) {
+
+	_dataLock.lock();
+	if ( handle < 0 || handle >= (ProbeHandle)_probes.size() ) {
 		_dataLock.unlock();
+		Log::w( "Invalid probe handle in sweep (ignoring): %d", handle );
+		return;
+	}
 
-		try {
-			temp = sensor->getTemperature( time );
+	ProbeEntry& entry = _probes[handle];
+	ProbeStats& stats = entry._stats;
+	ProbeStats oldStats = stats;
 
-			// Log::i( "%lld: %s = %d", time, sensorId.getString().c_str(), temp );
-			
-			_dataLock.lock();
-			stats._numSuccess++;
-			stats._lastTemp = temp;
-			stats._lastSeen = time;
-			_dataLock.unlock();
+	SampleFilter::Result result = SampleFilter::Result::ACCEPTED;
+	if ( success ) {
+		stats._rawTemp = temp;
+		result = entry._filter.add( temp, time );
+	}
 
-		} catch ( const exception& e ) {
+	updateHealth( entry, success );
 
-			_dataLock.lock();
-			stats._numErrors++;
+	bool accepted = (success && result == SampleFilter::Result::ACCEPTED);
+	if ( accepted ) {
+		stats._numSuccess++;
 
-			Log::w( 
-					"Exception while trying to read probe %s (error count: %ld): \n  %s",
-					sensorId.getString().c_str(),
-					stats._numErrors,
-					e.what() );
-			_dataLock.unlock();
-		} catch ( ... ) {
+		// the median keeps its own sample's time; one older than what's
+		// published already (the median moved back to an earlier sample)
+		// leaves the published sample as it is
+		i64 filteredTime = entry._filter.getFilteredTime();
+		if ( stats._numSuccess == 1 || filteredTime > stats._lastSeen ) {
+			stats._lastTemp = entry._filter.getFiltered();
+			stats._lastSeen = filteredTime;
 
-			_dataLock.lock();
-			stats._numErrors++;
+			// the estimate follows the published temperature, not the raw samples
+			entry._estimator.update( (f32)stats._lastTemp / 1000.0f, stats._lastSeen );
+		}
+		stats._sampleAge = (i32)std::max( (i64)0, time - issued );
+	} else if ( success ) {
+		stats._numRejected++;
+
+		Log::w( 
+				"Rejected sample %d from probe %s (%s, rejected count: %ld)",
+				temp,
+				stats._id.getString().c_str(),
+				SampleFilter::getResultName( result ),
+				stats._numRejected );
+	} else {
+		stats._numErrors++;
+
+		Log::w( 
+				"Exception while trying to read probe %s (error count: %ld): \n  %s",
+				stats._id.getString().c_str(),
+				stats._numErrors,
+				error.c_str() );
+	}
 
-			Log::w( 
-					"Exception while trying to read probe %s (error count: %ld)",
-					sensorId.getString().c_str(),
-					stats._numErrors );
-			_dataLock.unlock();
+	ProbeStats newStats = stats;
+	entry._slot->store( newStats );
+	ProbeMailbox* mailbox = entry._mailbox.get();
+
+	// the virtual probes fused from this one
+	vector<StatsEvent> fused;
+	for ( ProbeHandle fusedHandle : entry._fusedInto ) {
+		ProbeEntry& fusedEntry = _probes[fusedHandle];
+		StatsEvent event;
+		event._before = fusedEntry._stats;
+		if ( fuseProbe( fusedEntry, accepted )) {
+			fusedEntry._slot->store( fusedEntry._stats );
+			event._after = fusedEntry._stats;
+			event._mailbox = fusedEntry._mailbox.get();
+			fused.push_back( event );
 		}
+	}
+	_dataLock.unlock();
 
-		fireProbeStatsChangedEvent( oldStats, stats );
+	postStatsEvent( mailbox, oldStats, newStats );
+	for ( auto& event : fused ) {
+		postStatsEvent( event._mailbox, event._before, event._after );
+	}
+}
 
+// updateHealth
+void TemperatureManager::updateHealth( ProbeEntry& entry, bool success ) {
 
-		// Log::i( " - %s: %d", sensorId.getString().c_str(), temp );
+	ProbeStats& stats = entry._stats;
+	ProbeHealth health = stats._health;
 
-		// TODO: review this
-		_dataLock.lock();
-		_dataLock.unlock();
+	if ( success ) {
+		entry._failedReads = 0;
+		if ( health == ProbeHealth::QUARANTINED ) {
+			health = ProbeHealth::SUSPECT;
+			entry._nextRead = 0; // back to its normal rate
+		} else {
+			health = ProbeHealth::HEALTHY;
+			entry._backoff = 0;
+		}
+	} else {
+		entry._failedReads++;
+		if ( health == ProbeHealth::HEALTHY ) {
+			health = ProbeHealth::SUSPECT;
+		}
+
+		// every failure in quarantine doubles the wait for the next read
+		if ( entry._failedReads >= AB_PROBE_QUARANTINE_FAILURES ) {
+			health = ProbeHealth::QUARANTINED;
+			entry._backoff = (entry._backoff == 0
+					? AB_PROBE_MIN_BACKOFF
+					: std::min( entry._backoff * 2, AB_PROBE_MAX_BACKOFF ));
+			entry._nextRead = std::max( entry._nextRead, getTime() + entry._backoff );
+			stats._pollInterval = entry._backoff;
+		}
+	}
+
+	if ( health != stats._health ) {
+		Log::i( "Probe %s is now %s (was %s)",
+				stats._id.getString().c_str(),
+				getProbeHealthName( health ),
+				getProbeHealthName( stats._health ));
+		stats._health = health;
+	}
+}
+
+// linkVirtualProbes
+void TemperatureManager::linkVirtualProbes() {
+
+	for ( auto& entry : _probes ) {
+		entry._fusedInto.clear();
+	}
+
+	for ( size_t i = 0; i < _probes.size(); i++ ) {
+		ProbeEntry& entry = _probes[i];
+		if ( ! entry._virtual ) {
+			continue;
+		}
+
+		// virtual probes are only fused from physical ones
+		entry._sources.clear();
+		for ( auto& sourceId : entry._fusion._sources ) {
+			ProbeHandle source = findProbe( sourceId );
+			if ( source != AB_INVALID_PROBE_HANDLE && _probes[source]._virtual ) {
+				source = AB_INVALID_PROBE_HANDLE;
+			}
+			entry._sources.push_back( source );
+
+			if ( source != AB_INVALID_PROBE_HANDLE && entry._present ) {
+				_probes[source]._fusedInto.push_back( (ProbeHandle)i );
+			}
+		}
+	}
+}
+
+// updateDemand
+void TemperatureManager::updateDemand() {
+
+	vector<ProbePriority> priorities( _probes.size(), ProbePriority::NORMAL );
+	for ( size_t i = 0; i < _probes.size(); i++ ) {
+		ProbeEntry& entry = _probes[i];
+
+		ProbePriority priority = ProbePriority::NORMAL;
+		if ( _demandedProbes.find( entry._settings._id ) != _demandedProbes.end() ) {
+			priority = ProbePriority::CRITICAL;
+		} else if ( _subscribedProbes.find( entry._settings._id ) != _subscribedProbes.end() ) {
+			priority = ProbePriority::SUBSCRIBED;
+		} else {
+			continue;
+		}
+
+		// a virtual probe passes its priority on to its sources
+		priorities[i] = std::min( priorities[i], priority );
+		if ( entry._virtual && entry._present ) {
+			for ( ProbeHandle source : entry._sources ) {
+				if ( source != AB_INVALID_PROBE_HANDLE ) {
+					priorities[source] = std::min( priorities[source], priority );
+				}
+			}
+		}
+	}
+
+	for ( size_t i = 0; i < _probes.size(); i++ ) {
+		ProbeEntry& entry = _probes[i];
+		bool demanded = (priorities[i] == ProbePriority::CRITICAL);
+
+		// newly demanded probes are due right away
+		if ( demanded && ! entry._demanded ) {
+			entry._nextRead = 0;
+		}
+		entry._demanded = demanded;
+		entry._stats._priority = priorities[i];
+	}
+}
+
+// fuseProbe
+bool TemperatureManager::fuseProbe( ProbeEntry& entry, bool accepted ) {
+
+	const VirtualProbeSettings& fusion = entry._fusion;
+	ProbeStats& stats = entry._stats;
+	i64 now = getTime();
+
+	f64 sum = 0.0;
+	f64 weights = 0.0;
+	i32 minTemp = 0;
+	i32 maxTemp = 0;
+	i64 lastSeen = 0;
+	i32 pollInterval = 0;
+	bool active = false;
+	i32 count = 0;
+
+	for ( size_t i = 0; i < entry._sources.size(); i++ ) {
+		if ( entry._sources[i] == AB_INVALID_PROBE_HANDLE ) {
+			continue;
+		}
+
+		// stale sources drop out and the rest share their weight
+		const ProbeEntry& source = _probes[entry._sources[i]];
+		const ProbeStats& sourceStats = source._stats;
+		if ( ! source._present || sourceStats._numSuccess == 0 || now - sourceStats._lastSeen > fusion._maxAge ) {
+			continue;
+		}
+
+		f64 weight = 1.0;
+		if ( fusion._mode == FusionMode::WEIGHTED_MEAN && i < fusion._weights.size() ) {
+			weight = fusion._weights[i];
+		} else if ( fusion._mode == FusionMode::INVERSE_VARIANCE ) {
+			f64 stdDev = source._estimator.predict( now )._stdDev;
+			weight = 1.0 / std::max( stdDev * stdDev, AB_FUSION_MIN_VARIANCE );
+		}
+		if ( weight <= 0.0 ) {
+			continue;
+		}
+
+		i32 temp = sourceStats._lastTemp;
+		minTemp = (count == 0 ? temp : std::min( minTemp, temp ));
+		maxTemp = (count == 0 ? temp : std::max( maxTemp, temp ));
+		sum += weight * temp;
+		weights += weight;
+		lastSeen = std::max( lastSeen, sourceStats._lastSeen );
+		pollInterval = (count == 0 ? sourceStats._pollInterval : std::min( pollInterval, sourceStats._pollInterval ));
+		active = (active || sourceStats._active);
+		count++;
+	}
+
+	// nothing to fuse: an error per new sample we couldn't use, or per poll
+	// interval without one, rather than per source read
+	if ( count == 0 ) {
+		i64 interval = (stats._pollInterval > 0 ? stats._pollInterval : fusion._maxAge);
+		if ( ! accepted && now - entry._lastFusionError < interval ) {
+			return false;
+		}
+		stats._numErrors++;
+		entry._lastFusionError = now;
+		return true;
+	}
+
+	// only a new sample makes a new value
+	if ( ! accepted ) {
+		return false;
+	}
 
+	i32 temp = (i32)std::lround( sum / weights );
+	if ( fusion._mode == FusionMode::MIN ) {
+		temp = minTemp;
+	} else if ( fusion._mode == FusionMode::MAX ) {
+		temp = maxTemp;
 	}
+
+	stats._numSuccess++;
+	stats._lastTemp = temp;
+	stats._rawTemp = temp;
+	stats._lastSeen = lastSeen;
+	stats._pollInterval = pollInterval;
+	stats._active = active;
+	entry._estimator.update( (f32)temp / 1000.0f, lastSeen );
+	return true;
+}
+
+// publishProbeTable
+void TemperatureManager::publishProbeTable() {
+
+	shared_ptr<ProbeTable> table = std::make_shared<ProbeTable>();
+	for ( auto& entry : _probes ) {
+		if ( entry._present ) {
+			table->_sensorIds.push_back( entry._settings._id );
+		}
+		table->_handles[entry._settings._id] = entry._stats._handle;
+		table->_slots.push_back( entry._slot.get() );
+	}
+
+	// the old table goes once the last reader holding it lets go
+	std::atomic_store( &_probeTable, shared_ptr<const ProbeTable>( table ));
 }
 
 // dumpTempData
 void TemperatureManager::dumpTempData() {
 
 	// dump as html
-	auto probeIds = listProbes();
+	shared_ptr<const vector<StringId>> probes = getProbes();
+	const vector<StringId>& probeIds = *probes;
 
 	ofstream htmlOut;
 	htmlOut.open( "/var/www/html/temp_data.html", ios::trunc | ios::out );
@@ -318,8 +1447,16 @@ void TemperatureManager::dumpTempData() {
 		f32 f = (9.0f / 5.0f) * c + 32.0f;
 
 		jsonOut << "        \"tempC\": " << c << ",\n"
+			    << "        \"rawTempC\": " << ((f32)probeStats._rawTemp / 1000.0f) << ",\n"
+			    << "        \"rejected\": " << probeStats._numRejected << ",\n"
 			    << "        \"tempF\": " << f << ",\n"
-			    << "        \"lastSeen\": " << probeStats._lastSeen << "\n";
+			    << "        \"lastSeen\": " << probeStats._lastSeen << ",\n"
+			    << "        \"pollInterval\": " << probeStats._pollInterval << ",\n"
+			    << "        \"resolution\": " << probeStats._resolution << ",\n"
+			    << "        \"active\": " << (probeStats._active ? "true" : "false") << ",\n"
+			    << "        \"health\": \"" << getProbeHealthName( probeStats._health ) << "\",\n"
+			    << "        \"priority\": " << (i32)probeStats._priority << ",\n"
+			    << "        \"sampleAge\": " << probeStats._sampleAge << "\n";
 
 		if (counter == probeIds.size()) {
 			jsonOut << "    }\n";
@@ -336,10 +1473,76 @@ void TemperatureManager::dumpTempData() {
 // fireProbeStatsChangedEvent
 void TemperatureManager::fireProbeStatsChangedEvent( const ProbeStats& before, const ProbeStats& after ) {
 
+	i64 now = getTime();
+
+	// call the listeners without the lock, so a slow one doesn't hold up
+	// adding and removing listeners; only this thread touches what was delivered
+	vector<shared_ptr<StatsSubscriber>> subscribers;
 	_eventLock.lock();
-	for ( auto callback : _probeStatsListeners ) {
+	for ( auto subscriber : _probeStatsListeners ) {
+		subscribers.push_back( subscriber );
+	}
+	_eventLock.unlock();
+
+	for ( auto& subscriber : subscribers ) {
+		const StatsSubscription& subscription = subscriber->_subscription;
+		if ( ! subscription._probes.empty() && subscription._probes.count( after._id ) == 0 ) {
+			continue;
+		}
+
+		// compare with what this listener last saw of the probe
+		const ProbeStats* delivered = &before;
+		auto itr = subscriber->_delivered.find( after._id );
+		if ( itr != subscriber->_delivered.end() ) {
+			delivered = &itr->second;
+
+			bool changed = (std::abs( (i64)after._lastTemp - delivered->_lastTemp ) >= subscription._minChange
+					|| (subscription._errors && after._numErrors != delivered->_numErrors));
+			if ( ! changed || now - subscriber->_deliveredAt[after._id] < subscription._minInterval ) {
+				_filteredEvents++;
+				continue;
+			}
+		}
+
+		ProbeStats previous = *delivered;
+		subscriber->_delivered[after._id] = after;
+		subscriber->_deliveredAt[after._id] = now;
+
 		try {
-			callback( before, after );
+			subscriber->_listener( previous, after );
+		} catch ( const exception& e ) {
+			Log::w( "Warning: exception caught while trying to make callback (ignoring): %s", e.what() );
+		} catch ( ... ) {
+			Log::w( "Warning: unrecognized exception caught while trying to make callback (ignoring)" );
+		}
+	}
+}
+
+// fireProbeRemovedEvent
+void TemperatureManager::fireProbeRemovedEvent( const ProbeSettings& settings, const ProbeStats& stats ) {
+
+	Log::i( "Firing probe removed event (%s)", settings._id.getString().c_str() );
+
+	_eventLock.lock();
+	for ( auto callback : _removedProbeListeners ) {
+		try {
+			callback( settings, stats );
+		} catch ( const exception& e ) {
+			Log::w( "Warning: exception caught while trying to make callback (ignoring): %s", e.what() );
+		} catch ( ... ) {
+			Log::w( "Warning: unrecognized exception caught while trying to make callback (ignoring)" );
+		}
+	}
+	_eventLock.unlock();
+}
+
+// fireProbeHealthChangedEvent
+void TemperatureManager::fireProbeHealthChangedEvent( const ProbeStats& stats, ProbeHealth before ) {
+
+	_eventLock.lock();
+	for ( auto callback : _healthListeners ) {
+		try {
+			callback( stats, before );
 		} catch ( const exception& e ) {
 			Log::w( "Warning: exception caught while trying to make callback (ignoring): %s", e.what() );
 		} catch ( ... ) {
@@ -366,3 +1569,30 @@ void TemperatureManager::fireProbeAddedEvent( const ProbeSettings& settings, con
 	}
 	_eventLock.unlock();
 }
+
+// to_json
+void to_json(json& j, const EventQueueStats& stats) {
+	j = json {
+		{"capacity", stats._capacity},
+		{"depth", stats._depth},
+		{"maxDepth", stats._maxDepth},
+		{"posted", stats._posted},
+		{"delivered", stats._delivered},
+		{"dropped", stats._dropped},
+		{"coalesced", stats._coalesced},
+		{"filtered", stats._filtered}
+	};
+}
+
+// getProbeHealthName
+const char* getProbeHealthName( ProbeHealth health ) {
+	switch ( health ) {
+		case ProbeHealth::HEALTHY:
+			return "healthy";
+		case ProbeHealth::SUSPECT:
+			return "suspect";
+		case ProbeHealth::QUARANTINED:
+			return "quarantined";
+	}
+	return "unknown";
+}
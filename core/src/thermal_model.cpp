@@ -0,0 +1,141 @@
+#include "thermal_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+using json = nlohmann::json;
+
+// Constructor
+ThermalModel::ThermalModel( f32 liquidMass, f32 elementWatts, f32 lossCoefficient, f32 ambientTemp ) :
+				_liquidMass(liquidMass),
+				_elementWatts(elementWatts),
+				_lossCoefficient(lossCoefficient),
+				_ambientTemp(ambientTemp) {
+}
+
+// getHeatCapacity
+f32 ThermalModel::getHeatCapacity() const {
+	return _liquidMass * AB_WATER_SPECIFIC_HEAT;
+}
+
+// getSteadyStateLoad
+f32 ThermalModel::getSteadyStateLoad( f32 temp ) const {
+	if ( _elementWatts <= 0.0f ) {
+		return 0.0f;
+	}
+
+	f32 lossWatts = _lossCoefficient * (temp - _ambientTemp);
+	return std::max( 0.0f, lossWatts / _elementWatts );
+}
+
+// getRampLoad
+f32 ThermalModel::getRampLoad( f32 rate ) const {
+	if ( _elementWatts <= 0.0f ) {
+		return 0.0f;
+	}
+
+	return (getHeatCapacity() * rate) / _elementWatts;
+}
+
+// getFeedForwardLoad
+f32 ThermalModel::getFeedForwardLoad( f32 setpoint, f32 setpointRate ) const {
+	f32 load = getSteadyStateLoad( setpoint ) + getRampLoad( setpointRate );
+	return std::min( 1.0f, std::max( 0.0f, load ));
+}
+
+// getProcessGain
+f32 ThermalModel::getProcessGain() const {
+	return _elementWatts / std::max( AB_THERMAL_MODEL_MIN_LOSS, _lossCoefficient );
+}
+
+// getTimeConstant
+f32 ThermalModel::getTimeConstant() const {
+	return getHeatCapacity() / std::max( AB_THERMAL_MODEL_MIN_LOSS, _lossCoefficient );
+}
+
+// getTimeToTemp
+f32 ThermalModel::getTimeToTemp( f32 fromTemp, f32 toTemp, f32 load ) const {
+	if ( fromTemp == toTemp ) {
+		return 0.0f;
+	}
+
+	// T(t) = Tss + (T0 - Tss) * e^(-t / tau), solved for t
+	f32 steadyStateTemp = _ambientTemp + (getProcessGain() * load);
+	f32 startGap = fromTemp - steadyStateTemp;
+	f32 endGap = toTemp - steadyStateTemp;
+
+	// the target must lie strictly between the start and the steady state
+	if ( startGap == 0.0f || (endGap / startGap) <= 0.0f || std::fabs( endGap ) >= std::fabs( startGap )) {
+		return -1.0f;
+	}
+
+	return getTimeConstant() * std::log( startGap / endGap );
+}
+
+// getTempAfter
+f32 ThermalModel::getTempAfter( f32 fromTemp, f32 load, f32 duration ) const {
+	f32 steadyStateTemp = _ambientTemp + (getProcessGain() * load);
+	return steadyStateTemp + ((fromTemp - steadyStateTemp) * std::exp( -duration / getTimeConstant() ));
+}
+
+// getLoadToReach
+f32 ThermalModel::getLoadToReach( f32 fromTemp, f32 toTemp, f32 duration ) const {
+	if ( duration <= 0.0f || getProcessGain() <= 0.0f ) {
+		return 0.0f;
+	}
+
+	// the steady state temperature whose response passes through toTemp at duration
+	f32 decay = std::exp( -duration / getTimeConstant() );
+	f32 steadyStateTemp = (toTemp - (fromTemp * decay)) / (1.0f - decay);
+	return (steadyStateTemp - _ambientTemp) / getProcessGain();
+}
+
+// setLiquidMass
+void ThermalModel::setLiquidMass( f32 liquidMass ) {
+	_liquidMass = liquidMass;
+}
+
+// getLiquidMass
+f32 ThermalModel::getLiquidMass() const {
+	return _liquidMass;
+}
+
+// setElementWatts
+void ThermalModel::setElementWatts( f32 elementWatts ) {
+	_elementWatts = elementWatts;
+}
+
+// getElementWatts
+f32 ThermalModel::getElementWatts() const {
+	return _elementWatts;
+}
+
+// setLossCoefficient
+void ThermalModel::setLossCoefficient( f32 lossCoefficient ) {
+	_lossCoefficient = lossCoefficient;
+}
+
+// getLossCoefficient
+f32 ThermalModel::getLossCoefficient() const {
+	return _lossCoefficient;
+}
+
+// setAmbientTemp
+void ThermalModel::setAmbientTemp( f32 ambientTemp ) {
+	_ambientTemp = ambientTemp;
+}
+
+// getAmbientTemp
+f32 ThermalModel::getAmbientTemp() const {
+	return _ambientTemp;
+}
+
+// to_json
+void to_json(json& j, const ThermalModel& model) {
+	j = json {
+		{"liquidMass", model.getLiquidMass()},
+		{"elementWatts", model.getElementWatts()},
+		{"lossCoefficient", model.getLossCoefficient()},
+		{"ambientTemp", model.getAmbientTemp()}
+	};
+}
@@ -0,0 +1,145 @@
+#include "thermal_model_estimator.h"
+
+#include <cmath>
+
+using json = nlohmann::json;
+
+#define AB_ESTIMATOR_MIN_UPDATES 10
+#define AB_ESTIMATOR_PROBE_RESOLUTION 0.0625 // C, DS18B20 at 12 bits
+
+// Constructor
+ThermalModelEstimator::ThermalModelEstimator( const ThermalModel& prior, f32 forgettingFactor, f32 window ) :
+				_forgettingFactor(forgettingFactor),
+				_window(window) {
+	reset( prior );
+}
+
+// reset
+void ThermalModelEstimator::reset( const ThermalModel& prior ) {
+
+	_ambientTemp = prior.getAmbientTemp();
+
+	f64 capacity = std::max( 1.0f, prior.getHeatCapacity() );
+	_a = 1.0 / capacity;
+	_b = -(f64)prior.getLossCoefficient() / capacity;
+
+	// start with 100% uncertainty on both parameters, relative to the noise on
+	// the observed rate (one step of probe resolution over a window)
+	f64 rateNoise = AB_ESTIMATOR_PROBE_RESOLUTION / _window;
+	f64 noiseVariance = rateNoise * rateNoise;
+	_p[0][0] = (_a * _a) / noiseVariance;
+	_p[0][1] = 0.0;
+	_p[1][0] = 0.0;
+	_p[1][1] = std::max( _b * _b, _a * _a ) / noiseVariance;
+
+	_numUpdates = 0;
+	_started = false;
+}
+
+// addSample
+void ThermalModelEstimator::addSample( f32 temp, f32 power, f32 dt ) {
+
+	if ( ! _started ) {
+		_started = true;
+		_windowStartTemp = temp;
+		_windowElapsed = 0.0;
+		_windowEnergy = 0.0;
+		_windowTempIntegral = 0.0;
+		return;
+	}
+
+	if ( dt <= 0.0f ) {
+		return;
+	}
+
+	_windowElapsed += dt;
+	_windowEnergy += ((f64)power * dt);
+	_windowTempIntegral += ((f64)temp * dt);
+
+	if ( _windowElapsed < _window ) {
+		return;
+	}
+
+	// average over the window
+	f64 meanPower = _windowEnergy / _windowElapsed;
+	f64 meanExcessTemp = (_windowTempIntegral / _windowElapsed) - _ambientTemp;
+	f64 rate = ((f64)temp - _windowStartTemp) / _windowElapsed;
+
+	update( meanPower, meanExcessTemp, rate );
+
+	_windowStartTemp = temp;
+	_windowElapsed = 0.0;
+	_windowEnergy = 0.0;
+	_windowTempIntegral = 0.0;
+}
+
+// isConverged
+bool ThermalModelEstimator::isConverged() const {
+	return (_numUpdates >= AB_ESTIMATOR_MIN_UPDATES && _a > 0.0 && _b <= 0.0);
+}
+
+// getHeatCapacity
+f32 ThermalModelEstimator::getHeatCapacity() const {
+	return (_a > 0.0 ? (f32)(1.0 / _a) : 0.0f);
+}
+
+// getLossCoefficient
+f32 ThermalModelEstimator::getLossCoefficient() const {
+	return (_a > 0.0 ? (f32)std::max( 0.0, -_b / _a ) : 0.0f);
+}
+
+// getNumUpdates
+i32 ThermalModelEstimator::getNumUpdates() const {
+	return _numUpdates;
+}
+
+// apply
+ThermalModel ThermalModelEstimator::apply( const ThermalModel& model ) const {
+	ThermalModel result = model;
+	result.setLiquidMass( getHeatCapacity() / AB_WATER_SPECIFIC_HEAT );
+	result.setLossCoefficient( getLossCoefficient() );
+	return result;
+}
+
+// update
+void ThermalModelEstimator::update( f64 power, f64 excessTemp, f64 rate ) {
+
+	// phi = [power, excessTemp], theta = [a, b]
+	f64 phi[2] = { power, excessTemp };
+
+	// P * phi
+	f64 pPhi[2] = {
+		(_p[0][0] * phi[0]) + (_p[0][1] * phi[1]),
+		(_p[1][0] * phi[0]) + (_p[1][1] * phi[1])
+	};
+
+	f64 denominator = _forgettingFactor + (phi[0] * pPhi[0]) + (phi[1] * pPhi[1]);
+	if ( denominator <= 0.0 ) {
+		return;
+	}
+
+	f64 gain[2] = { pPhi[0] / denominator, pPhi[1] / denominator };
+
+	f64 error = rate - ((_a * phi[0]) + (_b * phi[1]));
+	_a += (gain[0] * error);
+	_b += (gain[1] * error);
+
+	// P = (P - gain * phi' * P) / lambda
+	for ( i32 row = 0; row < 2; row++ ) {
+		for ( i32 col = 0; col < 2; col++ ) {
+			_p[row][col] = (_p[row][col] - (gain[row] * pPhi[col])) / _forgettingFactor;
+		}
+	}
+
+	_numUpdates++;
+}
+
+// to_json
+void to_json(json& j, const ThermalModelEstimator& estimator) {
+	j = json {
+		{"converged", estimator.isConverged()},
+		{"heatCapacity", estimator.getHeatCapacity()},
+		{"lossCoefficient", estimator.getLossCoefficient()},
+		{"updates", estimator.getNumUpdates()}
+	};
+}
@@ -0,0 +1,74 @@
+#ifndef __AB2_OWFS_BULK_READER_INCLUDED__
+#define __AB2_OWFS_BULK_READER_INCLUDED__
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <roller/core/types.h>
+
+#include "owfs_sensors.h"
+
+#include "bulk_temperature_reader.h"
+
+using namespace roller;
+
+/**
+ * BulkTemperatureReader for the owfs devman backend. Writes owfs'
+ * simultaneous/temperature, which broadcasts a convert command to every probe
+ * on every bus at once, waits one conversion time, then reads each probe's
+ * latesttemp (the result of that conversion, without starting another one).
+ *
+ * A sweep costs one conversion plus N scratchpad reads instead of N
+ * conversions. The wait is cut short for lower resolutions (see
+ * setResolution()): 94 ms at 9 bit, 188 ms at 10 bit.
+ *
+ * The reader talks to owcapi directly, which keeps one set of adapters per
+ * process. Those belong to the owfs devman backend (OWFSHardwareManager): it
+ * calls OW_init() when it is constructed, and the reader never calls OW_init()
+ * or OW_finish() itself, so it never restarts the adapters under devman. The
+ * reader holds on to the manager so owcapi stays up for as long as the reader
+ * is in use.
+ */
+class OWFSBulkReader : public BulkTemperatureReader {
+
+public:
+
+	/**
+	 * Constructor. Throws if owcapi isn't up, i.e. the manager failed to open
+	 * its adapters.
+	 *
+	 * @param manager is the owfs devman backend that owns the adapters
+	 * @param conversionTime is how long (ms) to wait for a 12 bit conversion;
+	 *		750 ms covers DS18B20s. Each bit less halves it.
+	 */
+	OWFSBulkReader(std::shared_ptr<devman::OWFSHardwareManager> manager, i32 conversionTime = 750);
+
+	/**
+	 * Start one conversion on all probes, wait for it and read the results.
+	 */
+	void readAll(const std::vector<StringId>& sensorIds, std::vector<BulkSample>& samples) override;
+
+	/**
+	 * Request a resolution (9 to 12 bits) for a probe. It is written to the
+	 * probe, by one conversion at that resolution, on the next readAll() that
+	 * includes it. The probe keeps it until it is power cycled.
+	 *
+	 * The conversion wait is set by the highest resolution among the probes a
+	 * sweep reads, and a probe whose resolution hasn't been written (yet)
+	 * counts as 12 bit. So with idle probes left at 12 bit, sweeps of only the
+	 * demanded probes still get the shorter wait.
+	 */
+	void setResolution(const StringId& sensorId, i32 bits) override;
+
+private:
+
+	std::shared_ptr<devman::OWFSHardwareManager> _manager;
+	i32 _conversionTime;
+
+	std::mutex _lock;
+	std::map<StringId, i32> _resolutions; // requested
+	std::map<StringId, i32> _appliedResolutions; // written to the probe
+};
+
+#endif // __AB2_OWFS_BULK_READER_INCLUDED__
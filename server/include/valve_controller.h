@@ -2,9 +2,12 @@
 #define __AB2_VALVE_CONTROLLER_INCLUDED__
 
 #include <atomic>
+#include <functional>
 
 #include <roller/core/types.h>
 #include <roller/core/thread.h>
+#include <roller/core/mutex.h>
+#include <roller/core/indexed_container.h>
 
 #include <json.hpp>
 
@@ -18,6 +21,9 @@ using namespace roller;
  *
  * The ValveController can be set to several modes: On, off, and float. Float is described
  * above.
+ *
+ * Valve listeners are notified from the controller's thread whenever the valve
+ * opens or closes, along with the mode that did it.
  */
 class ValveController {
 
@@ -32,6 +38,11 @@ public:
 		FLOAT
 	};
 
+	/**
+	 * Called when the valve opens or closes.
+	 */
+	typedef std::function<void(Mode mode, bool open)> ValveListener;
+
 	/**
 	 * Constructor. The thread will not be started until start() is called.
 	 */
@@ -56,6 +67,16 @@ public:
 	 */
 	Mode getMode();
 
+	/**
+	 * Add a valve listener
+	 */
+	Key addValveListener(const ValveListener& listener);
+
+	/**
+	 * Remove a valve listener
+	 */
+	void removeValveListener(const Key& key);
+
 	/**
 	 * Start the thread. Call this to kick off the thread. Should only be called once.
 	 */
@@ -79,6 +100,11 @@ private:
 	 */
 	void run();
 
+	/**
+	 * Open or close the valve, notifying listeners if that changes anything.
+	 */
+	void setValveOpen(Mode mode, bool open);
+
 	Thread _thread;
 	std::atomic_bool _started;
 	std::atomic_bool _running;
@@ -86,6 +112,10 @@ private:
 	CurrentLimiter& _currentLimeter;
 	uint32_t _floatSwitchId;
 	uint32_t _valveSwitchId;
+	bool _valveOpen;
+
+	Mutex _listenerLock;
+	IndexedContainer<ValveListener> _valveListeners;
 };
 
 void to_json(nlohmann::json& j, const ValveController::Mode& mode);
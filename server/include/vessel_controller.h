@@ -0,0 +1,357 @@
+#ifndef __AB2_VESSEL_CONTROLLER_INCLUDED__
+#define __AB2_VESSEL_CONTROLLER_INCLUDED__
+
+#include <memory>
+#include <string>
+
+#include <roller/core/types.h>
+#include <roller/core/mutex.h>
+#include <roller/core/string_id.h>
+
+#include <json.hpp>
+
+#include "current_limiter.h"
+#include "disturbance_compensator.h"
+#include "gain_schedule.h"
+#include "heat_up_planner.h"
+#include "pid.h"
+#include "setpoint_profile.h"
+#include "smith_predictor.h"
+#include "thermal_model.h"
+#include "thermal_model_estimator.h"
+
+using namespace roller;
+
+/**
+ * Controls the element of a single vessel (HLT, BK). The element is driven
+ * through the CurrentLimiter either at a fixed PWM load or by a PID that tracks
+ * a setpoint on the vessel's temperature probe.
+ *
+ * In PID mode, a feed-forward load computed from the vessel's ThermalModel is
+ * added to the PID output so the PID only has to correct the residual. Its
+ * ramp term follows the SetpointProfile's ramp rate, not the setpoint's raw
+ * change, so a setpoint step or a cascade nudge doesn't swing it.
+ *
+ * In cascade mode (HERMS), an outer PID on a second probe (mash tun or return)
+ * computes the setpoint of the inner PID: the outer target plus an offset that
+ * is held within [minOffset, maxOffset]. The inner PID then runs as in PID mode.
+ *
+ * A SetpointProfile can drive the setpoint (or the cascade target) with ramps
+ * and soaks instead of jumping straight to it. The profile starts from the
+ * measured temperature on the next control cycle. Configuring a setpoint by
+ * hand stops any running profile.
+ *
+ * Dead time compensation optionally wraps the inner PID in a SmithPredictor. Its
+ * FOPDT model is either configured explicitly or derived from the ThermalModel.
+ *
+ * In MPC mode, a HeatUpPlanner shared by the vessels decides how much of the
+ * current budget each element gets while heating up (see setPlannedLoad()).
+ * The PID still runs, but its load is capped at the planned load until the
+ * vessel reaches its target; from then on the PID holds the target as usual.
+ *
+ * Known disturbances (pumps starting, the valve refilling the HLT) can be
+ * reported with onDisturbance(). A DisturbanceCompensator then bumps the
+ * feed-forward and scales up the PID gains for a while, per configured rule.
+ *
+ * Every vessel sample is fed to a ThermalModelEstimator along with the power
+ * the element actually delivered. Once the estimate converges it replaces the
+ * heat capacity and loss coefficient of the ThermalModel (unless learning is
+ * disabled), so feed-forward, dead time compensation and the time-to-setpoint
+ * estimate track the actual vessel contents.
+ *
+ * Configuration functions are called from the request handler and update() is
+ * called from the control loop; all functions are threadsafe.
+ */
+class VesselController {
+
+public:
+
+	/**
+	 * Constructor.
+	 *
+	 * @param id is the id of the vessel ("hlt", "bk"), used for logging and json
+	 * @param currentLimiter is the CurrentLimiter that owns the element pins
+	 * @param elementPin is the pin of the element's SSR (must be a PWM pin)
+	 * @param safetyPin is the pin of the element's safety relay
+	 * @param probeId is the id of the temperature probe in the vessel
+	 * @param model is the initial thermal model of the vessel
+	 */
+	VesselController(
+			const std::string& id,
+			CurrentLimiter& currentLimiter,
+			uint32_t elementPin,
+			uint32_t safetyPin,
+			const StringId& probeId,
+			const ThermalModel& model );
+
+	/**
+	 * Enable the element under PID control at the given setpoint (C).
+	 */
+	void configurePID( f32 setpoint );
+
+	/**
+	 * Enable the element at a fixed PWM load (0-1).
+	 */
+	void configurePWM( f32 load );
+
+	/**
+	 * Enable the element under cascade control.
+	 *
+	 * @param target is the temperature (C) to reach on the outer probe
+	 * @param outerProbeId is the id of the outer probe
+	 * @param minOffset is the minimum offset (C) of the inner setpoint from target
+	 * @param maxOffset is the maximum offset (C) of the inner setpoint from target
+	 */
+	void configureCascade( f32 target, const StringId& outerProbeId, f32 minOffset, f32 maxOffset );
+
+	/**
+	 * Enable the element under PID control at the given setpoint (C), with its
+	 * heat-up load planned by a HeatUpPlanner.
+	 */
+	void configureMPC( f32 target );
+
+	/**
+	 * Turn the element off.
+	 */
+	void turnOff();
+
+	/**
+	 * Returns the id of the vessel.
+	 */
+	const std::string& getId() const;
+
+	/**
+	 * Returns the mode: "off", "pwm", "pid", "cascade" or "mpc".
+	 */
+	std::string getMode() const;
+
+	/**
+	 * Returns true if the element is under PID control (including cascade and MPC).
+	 */
+	bool isPidEnabled() const;
+
+	/**
+	 * Returns true if the element's heat-up is planned by a HeatUpPlanner.
+	 */
+	bool isMPCEnabled() const;
+
+	/**
+	 * Returns true if the element is under cascade control.
+	 */
+	bool isCascadeEnabled() const;
+
+	/**
+	 * Returns the id of the outer probe used in cascade mode.
+	 */
+	StringId getOuterProbeId() const;
+
+	/**
+	 * Returns the PID setpoint (C).
+	 */
+	f32 getSetpoint() const;
+
+	/**
+	 * Returns the pin of the element's SSR.
+	 */
+	uint32_t getElementPin() const;
+
+	/**
+	 * Returns the id of the vessel's temperature probe.
+	 */
+	const StringId& getProbeId() const;
+
+	/**
+	 * Sets the ThermalModel used for feed-forward.
+	 */
+	void setThermalModel( const ThermalModel& model );
+
+	/**
+	 * Returns a copy of the ThermalModel used for feed-forward.
+	 */
+	ThermalModel getThermalModel() const;
+
+	/**
+	 * Enable or disable replacing the ThermalModel with the online estimate.
+	 */
+	void setModelLearningEnabled( bool enabled );
+
+	/**
+	 * Returns true if the ThermalModel is replaced with the online estimate.
+	 */
+	bool isModelLearningEnabled() const;
+
+	/**
+	 * Enable or disable the model based feed-forward term.
+	 */
+	void setFeedForwardEnabled( bool enabled );
+
+	/**
+	 * Returns true if the model based feed-forward term is enabled.
+	 */
+	bool isFeedForwardEnabled() const;
+
+	/**
+	 * Start a ramp/soak profile. Puts the element under PID control if it is
+	 * not already under PID or cascade control.
+	 *
+	 * @param steps are the profile steps
+	 * @param tolerance is how close (C) the temperature must be to a step's
+	 *		target before its soak starts
+	 */
+	void startProfile( const std::vector<ProfileStep>& steps, f32 tolerance );
+
+	/**
+	 * Stop the running profile, if any. The setpoint stays where the profile
+	 * left it.
+	 */
+	void stopProfile();
+
+	/**
+	 * Sets the GainSchedule of the inner PID. An empty schedule reverts to
+	 * the default gains.
+	 */
+	void setGainSchedule( const GainSchedule& gainSchedule );
+
+	/**
+	 * Configure dead time compensation (Smith predictor) for the inner PID.
+	 *
+	 * @param enabled turns compensation on or off
+	 * @param deadTime is the dead time (s) between the element and the probe
+	 * @param processGain is the model gain (C per % output), or 0 to derive it
+	 *		from the ThermalModel
+	 * @param timeConstant is the model time constant (s), or 0 to derive it
+	 *		from the ThermalModel
+	 */
+	void setDeadTimeCompensation( bool enabled, f32 deadTime, f32 processGain, f32 timeConstant );
+
+	/**
+	 * Add or replace the rule for how the inner PID reacts to a disturbance source.
+	 */
+	void setDisturbanceRule( const DisturbanceRule& rule );
+
+	/**
+	 * Remove the rule for a disturbance source.
+	 */
+	void removeDisturbanceRule( const std::string& source );
+
+	/**
+	 * Report a disturbance (e.g. "p1" when pump 1 turns on). Ignored unless
+	 * there is a rule for the source.
+	 */
+	void onDisturbance( const std::string& source );
+
+	/**
+	 * Run one cycle of the outer (cascade) loop, updating the inner setpoint.
+	 * Does nothing unless in cascade mode. Should be called right before update().
+	 *
+	 * @param outerTemp is the latest temperature of the outer probe (C)
+	 * @param dt is the time since the last cycle (s)
+	 */
+	void updateOuter( f32 outerTemp, f32 dt );
+
+	/**
+	 * Fill in the vessel for a HeatUpPlanner. Returns false unless in MPC mode
+	 * with a known temperature.
+	 */
+	bool getPlannerVessel( PlannerVessel& vessel ) const;
+
+	/**
+	 * Sets the load planned by the HeatUpPlanner for the next control cycles.
+	 */
+	void setPlannedLoad( const PlannedLoad& plannedLoad );
+
+	/**
+	 * Record a vessel sample for model identification. Should be called for
+	 * every fresh sample in every mode, right before update().
+	 *
+	 * @param temp is the latest vessel temperature (C)
+	 * @param dt is the time since the last sample (s)
+	 */
+	void observe( f32 temp, f32 dt );
+
+	/**
+	 * Run one control cycle. Does nothing unless in PID or cascade mode.
+	 *
+	 * @param temp is the latest vessel temperature (C)
+	 * @param dt is the time since the last cycle (s)
+	 */
+	void update( f32 temp, f32 dt );
+
+	/**
+	 * Convert to json
+	 */
+	void to_json( nlohmann::json& j ) const;
+
+private:
+
+	/**
+	 * Push a new load (0-1) for the element to the CurrentLimiter.
+	 * Returns the load the CurrentLimiter actually applied.
+	 */
+	f32 setElementLoad( f32 load );
+
+	/**
+	 * Returns the FOPDT process gain (C per % output) for dead time compensation.
+	 */
+	f32 getDeadTimeProcessGain() const;
+
+	/**
+	 * Returns the FOPDT time constant (s) for dead time compensation.
+	 */
+	f32 getDeadTimeTimeConstant() const;
+
+	/**
+	 * Returns the temperature (C) the vessel is heading for: the current profile
+	 * step's target if a profile is running, otherwise the setpoint.
+	 */
+	f32 getTargetTemp() const;
+
+	mutable Mutex _lock;
+	std::string _id;
+	CurrentLimiter& _currentLimiter;
+	uint32_t _elementPin;
+	uint32_t _safetyPin;
+	StringId _probeId;
+
+	std::string _mode;
+	f32 _setpoint;
+	ThermalModel _model;
+	bool _feedForwardEnabled;
+	GainSchedule _gainSchedule;
+
+	// model identification
+	ThermalModelEstimator _estimator;
+	bool _modelLearningEnabled;
+	f32 _lastTemp;
+	bool _lastTempValid;
+
+	// known disturbances
+	DisturbanceCompensator _disturbances;
+
+	// heat-up planning
+	PlannedLoad _plannedLoad;
+
+	SetpointProfile _profile;
+	std::vector<ProfileStep> _pendingProfileSteps;
+	bool _profilePending;
+
+	std::shared_ptr<PID> _pid;
+
+	// cascade
+	StringId _outerProbeId;
+	f32 _cascadeTarget;
+	f32 _minOffset;
+	f32 _maxOffset;
+	std::shared_ptr<PID> _outerPid;
+
+	// dead time compensation
+	bool _deadTimeEnabled;
+	f32 _deadTime;
+	f32 _deadTimeProcessGain;
+	f32 _deadTimeTimeConstant;
+	std::shared_ptr<SmithPredictor> _smithPredictor;
+};
+
+void to_json( nlohmann::json& j, const VesselController& controller );
+
+#endif // __AB2_VESSEL_CONTROLLER_INCLUDED__
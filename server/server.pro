@@ -16,6 +16,7 @@ INCLUDEPATH += include/ \
 
 LIBS += -lboost_program_options \
 		-lfcgi \
+		-lowcapi \
 
 debug:LIBS += -L../core/debug/ -lab2_core \
 		-L../../roller/core/debug/ -lroller_core \
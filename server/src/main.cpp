@@ -20,19 +20,30 @@
 #include "owfs_sensors.h"
 
 #include "temperature_manager.h"
+#include "sample_subscription.h"
 #include "current_limiter.h"
 #include "pid.h"
 #include "server_controller.h"
 #include "dummy_controller.h"
 #include "valve_controller.h"
+#include "vessel_controller.h"
+#include "owfs_bulk_reader.h"
+#include "heat_up_planner.h"
 
 #define AB_SERVER_FASTCGI_SOCKET "/var/run/ab.socket"
+#define AB_PROBE_INVENTORY_PATH "/var/lib/ab_probe_inventory.json"
 #define AB_SERVER_FASTCGI_BACKLOG 8
 
 // pin numbers
 // TODO: move elsewhere, organize better (config file?)
+#define AB_PUMP_1_PIN 18
+#define AB_PUMP_2_PIN 27
 #define AB_VALVE_PIN 22
 #define AB_FLOAT_PIN 14
+#define AB_BK_ELEMENT_PIN 17
+#define AB_BK_SAFETY_PIN 10
+#define AB_HLT_ELEMENT_PIN 4
+#define AB_HLT_SAFETY_PIN 24
 
 
 using namespace roller;
@@ -42,15 +53,6 @@ using json = nlohmann::json;
 // globals
 std::atomic_bool g_appRunning(false);
 
-std::atomic_bool g_hltPidEnabled(false);
-std::atomic_bool g_bkPidEnabled(false);
-std::string g_bkMode = "off";
-std::string g_hltMode = "off";
-volatile float g_hltSetpoint = -100.0f;
-volatile float g_bkSetpoint = -100.0f;
-StringId g_hltTempProbeId = StringId::intern("28.3AA87D040000");
-StringId g_bkTempProbeId = StringId::intern("28.EE9B8B040000");
-
 std::atomic<uint32_t> g_stateCounter = {0}; // changes each time there is a change in state
 
 CurrentLimiter g_currentLimiter(700, 35000); // base is 0.7 amps, total allowed 35 amps
@@ -59,6 +61,32 @@ ValveController g_valveController(
 		AB_FLOAT_PIN,
 		AB_VALVE_PIN);
 
+// devman manager of the 1-Wire probes, registered in main()
+StringId g_owfsManagerId;
+
+// reads the probes, started by pidLoop()
+TemperatureManager g_temperatureManager;
+
+// probes that aren't tied to an element, usable as the outer loop of a cascade
+StringId g_mashTempProbeId = StringId::intern("28.A1F07C040000");
+StringId g_returnTempProbeId = StringId::intern("28.42AB7D040000");
+
+// TODO: pull thermal models from config file (etc.)
+VesselController g_hltController(
+		"hlt",
+		g_currentLimiter,
+		AB_HLT_ELEMENT_PIN,
+		AB_HLT_SAFETY_PIN,
+		StringId::intern("28.3AA87D040000"),
+		ThermalModel(40.0f, 5500.0f, 8.0f, 20.0f)); // 40 kg, 5.5 kW, 8 W/C, 20 C ambient
+VesselController g_bkController(
+		"bk",
+		g_currentLimiter,
+		AB_BK_ELEMENT_PIN,
+		AB_BK_SAFETY_PIN,
+		StringId::intern("28.EE9B8B040000"),
+		ThermalModel(40.0f, 5500.0f, 10.0f, 20.0f)); // 40 kg, 5.5 kW, 10 W/C, 20 C ambient
+
 // handleSignal
 void handleSignal( i32 sig ) {
 
@@ -85,8 +113,16 @@ void handleSignal( i32 sig ) {
 // handleRequest
 void handleRequest( FCGX_Request& request );
 
+// timestamps of the samples a vessel's control loops last ran on
+struct VesselSampleTimes {
+	int64_t _inner = 0;
+	int64_t _outer = 0;
+};
+
 // loop to update PID algorithms
 void pidLoop();
+void updateVessel(VesselController& vessel, const std::map<StringId, ProbeStats>& samples, VesselSampleTimes& sampleTimes);
+void planHeatUp(const HeatUpPlanner& planner);
 
 // test Dummy controller
 void handleStartDummy();
@@ -94,6 +130,22 @@ void handleStopDummy();
 std::shared_ptr<DummyController> s_controller;
 
 void configCurrentLimiter();
+void configDisturbanceListeners();
+
+// vessel helpers
+VesselController& getVesselController(const std::string& id);
+void handleConfigureVessel(VesselController& vessel, std::map<std::string, std::string>& params);
+void handleConfigureModel(VesselController& vessel, std::map<std::string, std::string>& params);
+void handleConfigureDeadTime(VesselController& vessel, std::map<std::string, std::string>& params);
+void handleConfigureGains(VesselController& vessel, std::map<std::string, std::string>& params);
+void handleConfigureProfile(VesselController& vessel, std::map<std::string, std::string>& params);
+void handleConfigureDisturbance(VesselController& vessel, std::map<std::string, std::string>& params);
+
+// probe helpers
+void handleConfigureProbePoll(std::map<std::string, std::string>& params);
+void handleConfigureEvents(std::map<std::string, std::string>& params);
+void handleConfigureVirtualProbe(std::map<std::string, std::string>& params);
+void updateDemandedProbes();
 
 // main
 i32 main( i32 argc, char** argv ) {
@@ -118,10 +170,19 @@ i32 main( i32 argc, char** argv ) {
 
 		// initialize CurrentLimiter
 		configCurrentLimiter();
+		configDisturbanceListeners();
 
 		// initialize temperature manager
 		auto owfsManager = std::make_shared<OWFSHardwareManager>( "--usb all" );
-		StringId owfsManagerID = DeviceManager::registerTemperatureSensorManager( owfsManager );
+		g_owfsManagerId = DeviceManager::registerTemperatureSensorManager( owfsManager );
+
+		// one conversion per sweep for all 1-Wire probes, instead of one per probe;
+		// it uses the owcapi session the manager just opened
+		try {
+			g_temperatureManager.setBulkReader( g_owfsManagerId, std::make_shared<OWFSBulkReader>( owfsManager ));
+		} catch ( const exception& e ) {
+			Log::w( "Reading 1-Wire probes one by one: %s", e.what() );
+		}
 
 		// start PID thread
 		Thread pidThread(pidLoop);
@@ -288,44 +349,48 @@ void handleRequest( FCGX_Request& request ) {
 
 		json controlsJsonObj = {
 			{"valve", g_valveController.getMode()},
-			{"pump1", g_currentLimiter.getPinState(18)._desiredState},
-			{"pump2", g_currentLimiter.getPinState(27)._desiredState},
-			{"bk", g_bkMode},
-			{"hlt", g_hltMode}
+			{"pump1", g_currentLimiter.getPinState(AB_PUMP_1_PIN)._desiredState},
+			{"pump2", g_currentLimiter.getPinState(AB_PUMP_2_PIN)._desiredState},
+			{"bk", g_bkController.getMode()},
+			{"hlt", g_hltController.getMode()}
 		};
 		jsonObj["controls"] = controlsJsonObj;
 
 		// pid controllers
 		json pidJsonObj = {
-			{"bk", {
-				{"pid", g_bkPidEnabled.load()},
-				{"setpoint", g_bkSetpoint}
-			}},
-			{"hlt", {
-				{"pid", g_hltPidEnabled.load()},
-				{"setpoint", g_hltSetpoint}
-			}}
+			{"bk", g_bkController},
+			{"hlt", g_hltController}
 		};
 		jsonObj["pid"] = pidJsonObj;
 
+		// probe bus sweep metrics
+		json busesJsonObj = json::object();
+		for (auto entry : g_temperatureManager.getBusStats()) {
+			busesJsonObj[entry.first.getString()] = entry.second;
+		}
+		jsonObj["buses"] = busesJsonObj;
+
+		// stats event queue metrics
+		jsonObj["events"] = g_temperatureManager.getEventQueueStats();
+
 		jsonResponse = jsonObj.dump(4);
 		responseCode = 200;
 
 	// TODO: use wiring pi library here and track pin state?
 	} else if (handlerName == "p1_on") {
-		g_currentLimiter.enablePin(18);
+		g_currentLimiter.enablePin(AB_PUMP_1_PIN);
 		g_stateCounter++;
 
 	} else if (handlerName == "p1_off") {
-		g_currentLimiter.disablePin(18);
+		g_currentLimiter.disablePin(AB_PUMP_1_PIN);
 		g_stateCounter++;
 
 	} else if (handlerName == "p2_on") {
-		g_currentLimiter.enablePin(27);
+		g_currentLimiter.enablePin(AB_PUMP_2_PIN);
 		g_stateCounter++;
 
 	} else if (handlerName == "p2_off") {
-		g_currentLimiter.disablePin(27);
+		g_currentLimiter.disablePin(AB_PUMP_2_PIN);
 		g_stateCounter++;
 
 	} else if (handlerName == "valve_on") {
@@ -341,104 +406,43 @@ void handleRequest( FCGX_Request& request ) {
 		g_stateCounter++;
 
 	} else if (handlerName == "configure_bk") {
+		handleConfigureVessel(g_bkController, params);
+		g_stateCounter++;
 
-		bool enabled = Serialization::toBool(params["enabled"]);
-		if (enabled) {
-
-			// get optional "critical" field
-			bool critical = Serialization::toBool(params["critical"]);
-			// TODO: use critical field (requires mods to CurrentLimiter)
-
-			if (params["type"] == "") {
-				throw RollerException("configure_bk requires type when enabled=true");
-			} else if (params["type"] == "pid") {
-				if (params["setpoint"] == "") {
-					throw RollerException("configure_bk requires setpoint when type=pid");
-				} else {
-					f32 setpoint = Serialization::toF32(params["setpoint"]);
-					g_bkSetpoint = setpoint;
-					g_bkPidEnabled = true;
-					g_bkMode = "pid";
-					g_currentLimiter.enablePin(10);
-				}
-			} else if (params["type"] == "pwm") {
-				if (params["load"] == "") {
-					throw RollerException("configure_bk requires load when type=pwm");
-				} else {
-					f32 load = Serialization::toF32(params["load"]);
-					CurrentLimiter::PinConfiguration pinConfiguration = g_currentLimiter.getPinConfiguration(17);
-					pinConfiguration._pwmLoad = load;
-					g_currentLimiter.updatePinConfiguration(pinConfiguration);
-					g_currentLimiter.enablePin(10);
-					g_bkPidEnabled = false;
-					g_bkMode = "pwm";
-				}
-			} else {
-				throw RollerException("illegal type parameter (%s) for configure_bk", params["type"].c_str());
-			}
-		} else {
+	} else if (handlerName == "configure_hlt") {
+		handleConfigureVessel(g_hltController, params);
+		g_stateCounter++;
 
-			Log::i("Turning off BK");
+	} else if (handlerName == "configure_model") {
+		handleConfigureModel(getVesselController(params["vessel"]), params);
+		g_stateCounter++;
 
-			// set pwm load to 0
-			CurrentLimiter::PinConfiguration pinConfiguration = g_currentLimiter.getPinConfiguration(17);
-			pinConfiguration._pwmLoad = 0.0f;
-			g_currentLimiter.updatePinConfiguration(pinConfiguration);
+	} else if (handlerName == "configure_profile") {
+		handleConfigureProfile(getVesselController(params["vessel"]), params);
+		g_stateCounter++;
 
-			// disable safety
-			g_currentLimiter.disablePin(10);
+	} else if (handlerName == "configure_gains") {
+		handleConfigureGains(getVesselController(params["vessel"]), params);
+		g_stateCounter++;
 
-			// flag bk pid to stop
-			g_bkPidEnabled = false;
-			g_bkMode = "off";
-		}
+	} else if (handlerName == "configure_dead_time") {
+		handleConfigureDeadTime(getVesselController(params["vessel"]), params);
 		g_stateCounter++;
-	} else if (handlerName == "configure_hlt") {
 
-		bool enabled = Serialization::toBool(params["enabled"]);
-		if (enabled) {
-			if (params["type"] == "") {
-				throw RollerException("configure_hlt requires type when enabled=true");
-			} else if (params["type"] == "pid") {
-				if (params["setpoint"] == "") {
-					throw RollerException("configure_hlt requires setpoint when type=pid");
-				} else {
-					f32 setpoint = Serialization::toF32(params["setpoint"]);
-					g_hltSetpoint = setpoint;
-					g_hltPidEnabled = true;
-					g_hltMode = "pid";
-					g_currentLimiter.enablePin(24);
-				}
-			} else if (params["type"] == "pwm") {
-				if (params["load"] == "") {
-					throw RollerException("configure_hlt requires load when type=pwm");
-				} else {
-					f32 load = Serialization::toF32(params["load"]);
-					CurrentLimiter::PinConfiguration pinConfiguration = g_currentLimiter.getPinConfiguration(4);
-					pinConfiguration._pwmLoad = load;
-					g_currentLimiter.updatePinConfiguration(pinConfiguration);
-					g_currentLimiter.enablePin(24);
-					g_hltPidEnabled = false;
-					g_hltMode = "pwm";
-				}
-			} else {
-				throw RollerException("illegal type parameter (%s) for configure_hlt", params["type"].c_str());
-			}
-		} else {
-			Log::i("Turning off HLT");
+	} else if (handlerName == "configure_disturbance") {
+		handleConfigureDisturbance(getVesselController(params["vessel"]), params);
+		g_stateCounter++;
 
-			// set pwm load to 0
-			CurrentLimiter::PinConfiguration pinConfiguration = g_currentLimiter.getPinConfiguration(4);
-			pinConfiguration._pwmLoad = 0.0f;
-			g_currentLimiter.updatePinConfiguration(pinConfiguration);
+	} else if (handlerName == "configure_probe_poll") {
+		handleConfigureProbePoll(params);
+		g_stateCounter++;
 
-			// disable safety
-			g_currentLimiter.disablePin(24);
+	} else if (handlerName == "configure_events") {
+		handleConfigureEvents(params);
+		g_stateCounter++;
 
-			// flag hlt pid to stop
-			g_hltPidEnabled = false;
-			g_hltMode = "off";
-		}
+	} else if (handlerName == "configure_virtual_probe") {
+		handleConfigureVirtualProbe(params);
 		g_stateCounter++;
 
 	} else {
@@ -498,6 +502,270 @@ void handleStopDummy() {
 	s_controller.reset();
 }
 
+VesselController& getVesselController(const std::string& id) {
+	if (id == "hlt") {
+		return g_hltController;
+	} else if (id == "bk") {
+		return g_bkController;
+	}
+
+	throw RollerException("illegal vessel parameter (%s)", id.c_str());
+}
+
+void handleConfigureVessel(VesselController& vessel, std::map<std::string, std::string>& params) {
+
+	bool enabled = Serialization::toBool(params["enabled"]);
+	if (enabled) {
+
+		// get optional "critical" field
+		bool critical = Serialization::toBool(params["critical"]);
+		// TODO: use critical field (requires mods to CurrentLimiter)
+
+		if (params["type"] == "") {
+			throw RollerException("configure_%s requires type when enabled=true", vessel.getId().c_str());
+		} else if (params["type"] == "pid") {
+			if (params["setpoint"] == "") {
+				throw RollerException("configure_%s requires setpoint when type=pid", vessel.getId().c_str());
+			} else {
+				vessel.configurePID(Serialization::toF32(params["setpoint"]));
+			}
+		} else if (params["type"] == "pwm") {
+			if (params["load"] == "") {
+				throw RollerException("configure_%s requires load when type=pwm", vessel.getId().c_str());
+			} else {
+				vessel.configurePWM(Serialization::toF32(params["load"]));
+			}
+		} else if (params["type"] == "mpc") {
+			if (params["setpoint"] == "") {
+				throw RollerException("configure_%s requires setpoint when type=mpc", vessel.getId().c_str());
+			} else {
+				vessel.configureMPC(Serialization::toF32(params["setpoint"]));
+			}
+		} else if (params["type"] == "cascade") {
+			if (params["setpoint"] == "") {
+				throw RollerException("configure_%s requires setpoint when type=cascade", vessel.getId().c_str());
+			}
+
+			// outer probe defaults to the mash tun
+			StringId outerProbeId = g_mashTempProbeId;
+			if (params["probe"] == "return") {
+				outerProbeId = g_returnTempProbeId;
+			} else if (params["probe"] != "" && params["probe"] != "mash") {
+				throw RollerException("illegal probe parameter (%s) for configure_%s", params["probe"].c_str(), vessel.getId().c_str());
+			}
+
+			f32 minOffset = 0.0f;
+			f32 maxOffset = 10.0f;
+			if (params["min_offset"] != "") {
+				minOffset = Serialization::toF32(params["min_offset"]);
+			}
+			if (params["max_offset"] != "") {
+				maxOffset = Serialization::toF32(params["max_offset"]);
+			}
+
+			vessel.configureCascade(Serialization::toF32(params["setpoint"]), outerProbeId, minOffset, maxOffset);
+		} else {
+			throw RollerException("illegal type parameter (%s) for configure_%s", params["type"].c_str(), vessel.getId().c_str());
+		}
+	} else {
+		vessel.turnOff();
+	}
+}
+
+void handleConfigureModel(VesselController& vessel, std::map<std::string, std::string>& params) {
+
+	// all fields are optional; anything not given is left as is
+	ThermalModel model = vessel.getThermalModel();
+	if (params["mass"] != "") {
+		model.setLiquidMass(Serialization::toF32(params["mass"]));
+	}
+	if (params["watts"] != "") {
+		model.setElementWatts(Serialization::toF32(params["watts"]));
+	}
+	if (params["loss"] != "") {
+		model.setLossCoefficient(Serialization::toF32(params["loss"]));
+	}
+	if (params["ambient"] != "") {
+		model.setAmbientTemp(Serialization::toF32(params["ambient"]));
+	}
+	vessel.setThermalModel(model);
+
+	if (params["feed_forward"] != "") {
+		vessel.setFeedForwardEnabled(Serialization::toBool(params["feed_forward"]));
+	}
+	if (params["learn"] != "") {
+		vessel.setModelLearningEnabled(Serialization::toBool(params["learn"]));
+	}
+}
+
+void handleConfigureDeadTime(VesselController& vessel, std::map<std::string, std::string>& params) {
+
+	bool enabled = Serialization::toBool(params["enabled"]);
+	if (enabled && params["dead_time"] == "") {
+		throw RollerException("configure_dead_time requires dead_time when enabled=true");
+	}
+
+	// gain and time constant are optional; 0 derives them from the thermal model
+	f32 deadTime = (params["dead_time"] != "" ? Serialization::toF32(params["dead_time"]) : 0.0f);
+	f32 processGain = (params["gain"] != "" ? Serialization::toF32(params["gain"]) : 0.0f);
+	f32 timeConstant = (params["time_constant"] != "" ? Serialization::toF32(params["time_constant"]) : 0.0f);
+
+	vessel.setDeadTimeCompensation(enabled, deadTime, processGain, timeConstant);
+}
+
+void handleConfigureDisturbance(VesselController& vessel, std::map<std::string, std::string>& params) {
+
+	std::string source = params["source"];
+	if (source != "p1" && source != "p2" && source != "valve_float") {
+		throw RollerException("illegal source parameter (%s) for configure_disturbance", source.c_str());
+	}
+
+	if (! Serialization::toBool(params["enabled"])) {
+		vessel.removeDisturbanceRule(source);
+		return;
+	}
+
+	if (params["bump"] == "" || params["duration"] == "") {
+		throw RollerException("configure_disturbance requires bump and duration when enabled=true");
+	}
+
+	DisturbanceRule rule;
+	rule._source = source;
+	rule._bump = Serialization::toF32(params["bump"]);
+	rule._duration = Serialization::toF32(params["duration"]);
+	if (params["gain_scale"] != "") {
+		rule._gainScale = Serialization::toF32(params["gain_scale"]);
+	}
+	vessel.setDisturbanceRule(rule);
+}
+
+void handleConfigureProbePoll(std::map<std::string, std::string>& params) {
+
+	// no probe means the default policy
+	std::string probe = params["probe"];
+	if (probe != "" && Serialization::toBool(params["reset"])) {
+		g_temperatureManager.clearPollPolicy(StringId::intern(probe));
+		return;
+	}
+
+	// missing parameters keep their current values
+	ProbePollPolicy policy = g_temperatureManager.getPollPolicy(StringId::intern(probe));
+	if (params["active_interval"] != "") {
+		policy._activeInterval = Serialization::toI32(params["active_interval"]);
+	}
+	if (params["idle_interval"] != "") {
+		policy._idleInterval = Serialization::toI32(params["idle_interval"]);
+	}
+	if (params["active_resolution"] != "") {
+		policy._activeResolution = Serialization::toI32(params["active_resolution"]);
+	}
+	if (params["idle_resolution"] != "") {
+		policy._idleResolution = Serialization::toI32(params["idle_resolution"]);
+	}
+	if (params["stable_slope"] != "") {
+		policy._stableSlope = Serialization::toF32(params["stable_slope"]);
+	}
+
+	if (policy._activeInterval <= 0 || policy._idleInterval <= 0) {
+		throw RollerException("configure_probe_poll intervals must be positive");
+	}
+	if (policy._activeResolution < 9 || policy._activeResolution > 12
+			|| policy._idleResolution < 9 || policy._idleResolution > 12) {
+		throw RollerException("configure_probe_poll resolutions must be 9 to 12 bits");
+	}
+
+	if (probe == "") {
+		g_temperatureManager.setDefaultPollPolicy(policy);
+	} else {
+		g_temperatureManager.setPollPolicy(StringId::intern(probe), policy);
+	}
+}
+
+void handleConfigureEvents(std::map<std::string, std::string>& params) {
+
+	if (params["overflow"] == "drop_oldest") {
+		g_temperatureManager.setEventOverflowPolicy(EventOverflowPolicy::DROP_OLDEST);
+	} else if (params["overflow"] == "coalesce") {
+		g_temperatureManager.setEventOverflowPolicy(EventOverflowPolicy::COALESCE);
+	} else {
+		throw RollerException("illegal overflow parameter (%s) for configure_events", params["overflow"].c_str());
+	}
+}
+
+void handleConfigureVirtualProbe(std::map<std::string, std::string>& params) {
+
+	if (params["probe"] == "") {
+		throw RollerException("configure_virtual_probe requires a probe");
+	}
+	StringId probeId = StringId::intern(params["probe"]);
+
+	if (Serialization::toBool(params["remove"])) {
+		g_temperatureManager.removeVirtualProbe(probeId);
+		return;
+	}
+
+	VirtualProbeSettings settings;
+	if (params["mode"] == "" || params["mode"] == "mean") {
+		settings._mode = FusionMode::WEIGHTED_MEAN;
+	} else if (params["mode"] == "inverse_variance") {
+		settings._mode = FusionMode::INVERSE_VARIANCE;
+	} else if (params["mode"] == "min") {
+		settings._mode = FusionMode::MIN;
+	} else if (params["mode"] == "max") {
+		settings._mode = FusionMode::MAX;
+	} else {
+		throw RollerException("illegal mode parameter (%s) for configure_virtual_probe", params["mode"].c_str());
+	}
+
+	// comma separated, weights in the order of the sources
+	for (auto& source : split(params["sources"], ",")) {
+		if (source != "") {
+			settings._sources.push_back(StringId::intern(source));
+		}
+	}
+	if (params["weights"] != "") {
+		for (auto& weight : split(params["weights"], ",")) {
+			settings._weights.push_back(Serialization::toF32(weight));
+		}
+	}
+	if (params["max_age"] != "") {
+		settings._maxAge = Serialization::toI32(params["max_age"]);
+	}
+
+	g_temperatureManager.setVirtualProbe(probeId, settings);
+}
+
+void handleConfigureGains(VesselController& vessel, std::map<std::string, std::string>& params) {
+
+	// schedule is keyed on setpoint unless told otherwise
+	GainSchedule::Key key = GainSchedule::Key::SETPOINT;
+	if (params["key"] == "input") {
+		key = GainSchedule::Key::INPUT;
+	} else if (params["key"] != "" && params["key"] != "setpoint") {
+		throw RollerException("illegal key parameter (%s) for configure_gains", params["key"].c_str());
+	}
+
+	// an empty (or missing) table clears the schedule
+	vessel.setGainSchedule(GainSchedule::parse(params["table"], key));
+}
+
+void handleConfigureProfile(VesselController& vessel, std::map<std::string, std::string>& params) {
+
+	// empty (or missing) steps stops the profile
+	std::vector<ProfileStep> steps = SetpointProfile::parse(params["steps"]);
+	if (steps.empty()) {
+		vessel.stopProfile();
+		return;
+	}
+
+	f32 tolerance = 0.5f;
+	if (params["tolerance"] != "") {
+		tolerance = Serialization::toF32(params["tolerance"]);
+	}
+
+	vessel.startProfile(steps, tolerance);
+}
+
 void configCurrentLimiter() {
 
 	// TODO: pull this info from config file (etc.)
@@ -506,7 +774,7 @@ void configCurrentLimiter() {
 	CurrentLimiter::PinConfiguration config;
 	config._name = "Pump 1";
 	config._id = "p1";
-	config._pinNumber = 18;
+	config._pinNumber = AB_PUMP_1_PIN;
 	config._milliAmps = 1400;
 	config._critical = true;
 	config._pwm = false;
@@ -519,7 +787,7 @@ void configCurrentLimiter() {
 	// pump 2
 	config._name = "Pump 2";
 	config._id = "p2";
-	config._pinNumber = 27;
+	config._pinNumber = AB_PUMP_2_PIN;
 	config._milliAmps = 1400;
 	config._critical = true;
 	config._pwm = false;
@@ -545,7 +813,7 @@ void configCurrentLimiter() {
 	// BK element safety
 	config._name = "BK Element Safety";
 	config._id = "bk_safety";
-	config._pinNumber = 10;
+	config._pinNumber = AB_BK_SAFETY_PIN;
 	config._milliAmps = 34;
 	config._critical = true;
 	config._pwm = false;
@@ -558,7 +826,7 @@ void configCurrentLimiter() {
 	// HLT element safety
 	config._name = "HLT Element Safety";
 	config._id = "hlt_safety";
-	config._pinNumber = 24;
+	config._pinNumber = AB_HLT_SAFETY_PIN;
 	config._milliAmps = 34;
 	config._critical = true;
 	config._pwm = false;
@@ -571,7 +839,7 @@ void configCurrentLimiter() {
 	// BK element 
 	config._name = "BK Element";
 	config._id = "bk";
-	config._pinNumber = 17;
+	config._pinNumber = AB_BK_ELEMENT_PIN;
 	config._milliAmps = 23000;
 	config._critical = false;
 	config._pwm = true;
@@ -584,7 +852,7 @@ void configCurrentLimiter() {
 	// HLT element 
 	config._name = "HLT Element";
 	config._id = "hlt";
-	config._pinNumber = 4;
+	config._pinNumber = AB_HLT_ELEMENT_PIN;
 	config._milliAmps = 23000;
 	config._critical = false;
 	config._pwm = true;
@@ -595,88 +863,159 @@ void configCurrentLimiter() {
 			DeviceManager::getSwitch(RaspiGPIOSwitchManager::s_id, StringId::format("%d", config._pinNumber)));
 }
 
-void pidLoop() {
+void configDisturbanceListeners() {
 
-	// TODO: find a better home for this
-	TemperatureManager temperatureManager;
-	temperatureManager.run();
+	// pumps starting recirculation
+	g_currentLimiter.addPinListener([](uint32_t pin, bool enabled) {
+		if (! enabled) {
+			return;
+		}
 
-	bool hltSetup = false;
-	bool bkSetup = false;
+		std::string source;
+		if (pin == AB_PUMP_1_PIN) {
+			source = "p1";
+		} else if (pin == AB_PUMP_2_PIN) {
+			source = "p2";
+		} else {
+			return;
+		}
 
-	shared_ptr<PID> hltPID;
-	shared_ptr<PID> bkPID;
+		g_hltController.onDisturbance(source);
+		g_bkController.onDisturbance(source);
+	});
 
-	int64_t lastHLTPIDUpdateTime = getTime();
-	int64_t lastBKPIDUpdateTime = getTime();
+	// the float refilling a vessel during sparge
+	g_valveController.addValveListener([](ValveController::Mode mode, bool open) {
+		if (open && mode == ValveController::Mode::FLOAT) {
+			g_hltController.onDisturbance("valve_float");
+			g_bkController.onDisturbance("valve_float");
+		}
+	});
+}
 
+void updateVessel(VesselController& vessel, const std::map<StringId, ProbeStats>& samples, VesselSampleTimes& sampleTimes) {
+
+	// dt comes from the sensor timestamps; the first sample only establishes
+	// the time base
+	float innerTemp = 0.0f;
+	float innerDt = 0.0f;
+	auto itr = samples.find(vessel.getProbeId());
+	if (itr != samples.end()) {
+		const ProbeStats& stats = itr->second;
+		innerTemp = ((float)stats._lastTemp / 1000.f);
+		if (sampleTimes._inner > 0 && stats._lastSeen > sampleTimes._inner) {
+			innerDt = ((float)(stats._lastSeen - sampleTimes._inner) / 1000.0f);
+
+			// the model is identified in every mode, pwm and off included
+			vessel.observe( innerTemp, innerDt );
+		}
+		sampleTimes._inner = stats._lastSeen;
+	}
 
-	while (g_appRunning) {
+	if (! vessel.isPidEnabled()) {
+		vessel.updateOuter( 0.0f, 0.0f ); // releases the PIDs
+		vessel.update( 0.0f, 0.0f );
+		sampleTimes._outer = 0;
+		return;
+	}
 
-		// update HLT PID if needed
-		if (g_hltPidEnabled) {
+	// outer loop first, so a fresh inner sample runs against its new setpoint
+	if (vessel.isCascadeEnabled()) {
+		auto outerItr = samples.find(vessel.getOuterProbeId());
+		if (outerItr != samples.end()) {
+			const ProbeStats& stats = outerItr->second;
+			if (sampleTimes._outer > 0 && stats._lastSeen > sampleTimes._outer) {
+				float dt = ((float)(stats._lastSeen - sampleTimes._outer) / 1000.0f);
+				vessel.updateOuter( ((float)stats._lastTemp / 1000.f), dt );
+			}
+			sampleTimes._outer = stats._lastSeen;
+		}
+	} else {
+		// back in cascade, the outer loop starts over from its next sample
+		vessel.updateOuter( 0.0f, 0.0f ); // releases the outer PID
+		sampleTimes._outer = 0;
+	}
 
-			// initialize HLT PID if needed
-			if (! hltSetup) {
-				hltPID.reset(new PID(15.0f, 1.0f, 3.0f, g_hltSetpoint, -100.0f, 100.0f));
-				hltPID->setErrorAccumulationCap(1.5f);
-				hltSetup = true;
+	if (innerDt > 0.0f) {
+		vessel.update( innerTemp, innerDt );
+	}
+}
 
-				// TODO: enable safety pin
-			}
+void updateDemandedProbes() {
 
-			hltPID->setSetpoint(g_hltSetpoint);
+	// the probes of the loops that are running get read at the active rate
+	std::set<StringId> demanded;
+	for (VesselController* vessel : {&g_hltController, &g_bkController}) {
+		if (vessel->isPidEnabled()) {
+			demanded.insert(vessel->getProbeId());
+		}
+		if (vessel->isCascadeEnabled()) {
+			demanded.insert(vessel->getOuterProbeId());
+		}
+	}
 
-			ProbeStats stats = temperatureManager.getProbeStats(g_hltTempProbeId);
-			int32_t temp = stats._lastTemp;
+	g_temperatureManager.setDemandedProbes(demanded);
+}
 
-			int64_t now = getTime();
-			hltPID->update( ((float)temp / 1000.f), ((float)(now - lastHLTPIDUpdateTime) / 1000.0f) );
-			lastHLTPIDUpdateTime = now;
+void planHeatUp(const HeatUpPlanner& planner) {
 
-			// TODO: review / optimize -- this triggers a lot of work
-			CurrentLimiter::PinConfiguration pinConfiguration = g_currentLimiter.getPinConfiguration(4);
-			pinConfiguration._pwmLoad = std::max(0.0f, (hltPID->getOutput() / 100.0f ));
-			g_currentLimiter.updatePinConfiguration(pinConfiguration);
+	std::vector<VesselController*> vessels;
+	std::vector<PlannerVessel> plannerVessels;
+	std::set<uint32_t> pins;
 
-		} else if (hltSetup) {
-			Log::i("killing HLT pid...");
-			hltPID.reset();
-			hltSetup = false;
+	for (VesselController* vessel : {&g_hltController, &g_bkController}) {
+		PlannerVessel plannerVessel;
+		if (vessel->getPlannerVessel(plannerVessel)) {
+			vessels.push_back(vessel);
+			plannerVessels.push_back(plannerVessel);
+			pins.insert(vessel->getElementPin());
 		}
+	}
 
-		// update BK PID if needed
-		if (g_bkPidEnabled) {
+	if (vessels.empty()) {
+		return;
+	}
 
-			// initialize BK PID if needed
-			if (! bkSetup) {
-				bkPID.reset(new PID(15.0f, 1.0f, 3.0f, g_bkSetpoint, -100.0f, 100.0f));
-				bkPID->setErrorAccumulationCap(1.5f);
-				bkSetup = true;
+	// the planned elements share whatever the rest of the system leaves them
+	f32 available = (f32)g_currentLimiter.getAvailableMilliAmps(pins);
+	std::vector<PlannedLoad> plan = planner.plan(plannerVessels, available);
 
-				// TODO: enable safety pin
-			}
+	for (size_t i = 0; i < vessels.size(); i++) {
+		vessels[i]->setPlannedLoad(plan[i]);
+	}
+}
 
-			bkPID->setSetpoint(g_bkSetpoint);
+void pidLoop() {
 
-			ProbeStats stats = temperatureManager.getProbeStats(g_bkTempProbeId);
-			int32_t temp = stats._lastTemp;
+	// after a restart, read the probes we had right away rather than after discovery
+	g_temperatureManager.setInventoryPath(AB_PROBE_INVENTORY_PATH);
 
-			int64_t now = getTime();
-			bkPID->update( ((float)temp / 1000.f), ((float)(now - lastBKPIDUpdateTime) / 1000.0f) );
-			lastBKPIDUpdateTime = now;
+	// the controllers only want each probe's latest reading
+	g_temperatureManager.setEventOverflowPolicy(EventOverflowPolicy::COALESCE);
+	g_temperatureManager.run();
 
-			// TODO: review / optimize -- this triggers a lot of work
-			CurrentLimiter::PinConfiguration pinConfiguration = g_currentLimiter.getPinConfiguration(17);
-			pinConfiguration._pwmLoad = std::max(0.0f, (bkPID->getOutput() / 100.0f ));
-			g_currentLimiter.updatePinConfiguration(pinConfiguration);
+	// run the control loops as soon as fresh samples for their probes arrive
+	SampleSubscription subscription(g_temperatureManager);
+	std::map<StringId, ProbeStats> samples;
 
-		} else if (bkSetup) {
-			Log::i("killing BK pid...");
-			bkPID.reset();
-			bkSetup = false;
-		}
-		
-		usleep(1 * 1000 * 1000);
+	VesselSampleTimes hltSampleTimes;
+	VesselSampleTimes bkSampleTimes;
+
+	HeatUpPlanner planner;
+
+	while (g_appRunning) {
+
+		// time out now and then so disabled loops get released and we notice exit
+		subscription.waitForSamples(1000, samples);
+
+		updateDemandedProbes();
+
+		// plan on the temperatures from the last cycle, right before the PIDs run
+		planHeatUp(planner);
+
+		updateVessel(g_hltController, samples, hltSampleTimes);
+		updateVessel(g_bkController, samples, bkSampleTimes);
 	}
+
+	g_temperatureManager.stop();
 }
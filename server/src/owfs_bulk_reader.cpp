@@ -0,0 +1,121 @@
+#include "owfs_bulk_reader.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include <owcapi.h>
+
+#include <roller/core/exception.h>
+#include <roller/core/util.h>
+
+#define AB_OWFS_MAX_RESOLUTION 12
+#define AB_OWFS_MIN_RESOLUTION 9
+
+// Constructor
+OWFSBulkReader::OWFSBulkReader(std::shared_ptr<devman::OWFSHardwareManager> manager, i32 conversionTime)
+		: _manager(manager)
+		, _conversionTime(conversionTime)
+{
+	// owcapi fails every call until OW_init() succeeds, so listing the root
+	// tells us whether the manager got the adapters open
+	char* buffer = nullptr;
+	size_t length = 0;
+	if (OW_get("/", &buffer, &length) < 0 || buffer == nullptr) {
+		throw RollerException("owfs is not initialized (errno %d)", errno);
+	}
+	free(buffer);
+}
+
+// readAll
+void OWFSBulkReader::readAll(const std::vector<StringId>& sensorIds, std::vector<BulkSample>& samples) {
+
+	std::vector<std::pair<StringId, i32>> changes;
+	{
+		std::lock_guard<std::mutex> locker(_lock);
+		for (const StringId& sensorId : sensorIds) {
+			auto itr = _resolutions.find(sensorId);
+			i32 bits = (itr == _resolutions.end() ? AB_OWFS_MAX_RESOLUTION : itr->second);
+
+			auto applied = _appliedResolutions.find(sensorId);
+			if (itr != _resolutions.end() && (applied == _appliedResolutions.end() || applied->second != bits)) {
+				changes.push_back(std::make_pair(sensorId, bits));
+			}
+		}
+	}
+
+	// owfs writes the resolution to the probe's scratchpad when converting at it
+	for (auto change : changes) {
+		std::string path = "/uncached/" + change.first.getString() + "/temperature" + std::to_string(change.second);
+
+		char* buffer = nullptr;
+		size_t length = 0;
+		if (OW_get(path.c_str(), &buffer, &length) < 0 || buffer == nullptr) {
+			continue;
+		}
+		free(buffer);
+
+		std::lock_guard<std::mutex> locker(_lock);
+		_appliedResolutions[change.first] = change.second;
+	}
+
+	// the slowest probe we read sets the wait; one we haven't set (or failed
+	// to) is at its power-on 12 bit. Probes left out of the sweep convert
+	// too, but aren't read until a sweep that includes them waits for them.
+	i32 resolution = AB_OWFS_MIN_RESOLUTION;
+	{
+		std::lock_guard<std::mutex> locker(_lock);
+		for (const StringId& sensorId : sensorIds) {
+			auto applied = _appliedResolutions.find(sensorId);
+			resolution = std::max(resolution, (applied == _appliedResolutions.end() ? AB_OWFS_MAX_RESOLUTION : applied->second));
+		}
+	}
+
+	// uncached so owfs actually talks to the bus
+	if (OW_put("/uncached/simultaneous/temperature", "1", 1) < 0) {
+		throw RollerException("Failed to start simultaneous temperature conversion (errno %d)", errno);
+	}
+
+	usleep((_conversionTime >> (AB_OWFS_MAX_RESOLUTION - resolution)) * 1000);
+	i64 time = getTime();
+
+	samples.assign(sensorIds.size(), BulkSample());
+	bool anyValid = false;
+
+	for (size_t i = 0; i < sensorIds.size(); i++) {
+		std::string path = "/uncached/" + sensorIds[i].getString() + "/latesttemp";
+
+		char* buffer = nullptr;
+		size_t length = 0;
+		if (OW_get(path.c_str(), &buffer, &length) < 0 || buffer == nullptr) {
+			continue;
+		}
+
+		std::string value(buffer, length);
+		free(buffer);
+
+		char* end = nullptr;
+		f32 temp = strtof(value.c_str(), &end);
+		if (end == value.c_str()) {
+			continue;
+		}
+
+		samples[i]._valid = true;
+		samples[i]._temp = (i32)std::lround(temp * 1000.0f);
+		samples[i]._time = time;
+		anyValid = true;
+	}
+
+	if (! anyValid && ! sensorIds.empty()) {
+		throw RollerException("Simultaneous temperature conversion returned no readings");
+	}
+}
+
+// setResolution
+void OWFSBulkReader::setResolution(const StringId& sensorId, i32 bits) {
+	std::lock_guard<std::mutex> locker(_lock);
+	_resolutions[sensorId] = std::min(std::max(bits, AB_OWFS_MIN_RESOLUTION), AB_OWFS_MAX_RESOLUTION);
+}
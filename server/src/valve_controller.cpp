@@ -20,6 +20,8 @@ ValveController::ValveController(
 			, _currentLimeter(currentLimeter)
 			, _floatSwitchId(floatSwitchId)
 			, _valveSwitchId(valveSwitchId)
+			, _valveOpen(false)
+			, _listenerLock(true)
 {
 }
 
@@ -39,6 +41,18 @@ ValveController::Mode ValveController::getMode() {
 	return _mode;
 }
 
+// addValveListener
+Key ValveController::addValveListener(const ValveListener& listener) {
+	MutexLocker locker(_listenerLock);
+	return _valveListeners.add(listener);
+}
+
+// removeValveListener
+void ValveController::removeValveListener(const Key& key) {
+	MutexLocker locker(_listenerLock);
+	_valveListeners.remove(key);
+}
+
 // start
 void ValveController::start() {
 	if (_started) {
@@ -85,25 +99,21 @@ void ValveController::run() {
 		switch (_mode) {
 		case Mode::OFF:
 			if (changed) {
-				_currentLimeter.disablePin(_valveSwitchId);
+				setValveOpen(mode, false);
 			}
 			// TODO: turn off 
 			break;
 
 		case Mode::ON:
 			if (changed) {
-				_currentLimeter.enablePin(_valveSwitchId);
+				setValveOpen(mode, true);
 			}
 			// TODO: turn on
 			break;
 
 		case Mode::FLOAT:
 			bool floatState = floatSwitch->getState();
-			if (floatState) {
-				_currentLimeter.enablePin(_valveSwitchId);
-			} else {
-				_currentLimeter.disablePin(_valveSwitchId);
-			}
+			setValveOpen(mode, floatState);
 			break;
 		}
 
@@ -115,6 +125,29 @@ void ValveController::run() {
 	_started = false;
 }
 
+// setValveOpen
+void ValveController::setValveOpen(Mode mode, bool open) {
+	if (open) {
+		_currentLimeter.enablePin(_valveSwitchId);
+	} else {
+		_currentLimeter.disablePin(_valveSwitchId);
+	}
+
+	if (open == _valveOpen) {
+		return;
+	}
+	_valveOpen = open;
+
+	MutexLocker locker(_listenerLock);
+	for (auto callback : _valveListeners) {
+		try {
+			callback(mode, open);
+		} catch (const exception& e) {
+			Log::w("Caught exception in valve listener (ignoring): %s", e.what());
+		}
+	}
+}
+
 // to_json
 void to_json(nlohmann::json& j, const ValveController::Mode& mode) {
 	std::string str;
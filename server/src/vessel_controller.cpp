@@ -0,0 +1,576 @@
+#include "vessel_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <roller/core/log.h>
+#include <roller/core/exception.h>
+
+using json = nlohmann::json;
+
+#define AB_VESSEL_KP 15.0f // inner PID tunings, when there is no gain schedule
+#define AB_VESSEL_KI 1.0f
+#define AB_VESSEL_KD 3.0f
+#define AB_VESSEL_INTEGRAL_CAP 1.5f
+#define AB_VESSEL_TRACKING_GAIN 0.5f // back-calculation gain of the inner PID, which is told the applied load
+#define AB_VESSEL_MIN_LOAD -100.0f
+#define AB_VESSEL_MAX_LOAD 100.0f
+#define AB_CASCADE_KP 2.0f // outer PID tunings; its output is the inner setpoint offset
+#define AB_CASCADE_KI 0.01f
+#define AB_CASCADE_KD 0.0f
+
+// Constructor
+VesselController::VesselController(
+		const std::string& id,
+		CurrentLimiter& currentLimiter,
+		uint32_t elementPin,
+		uint32_t safetyPin,
+		const StringId& probeId,
+		const ThermalModel& model )
+			: _lock(true)
+			, _id(id)
+			, _currentLimiter(currentLimiter)
+			, _elementPin(elementPin)
+			, _safetyPin(safetyPin)
+			, _probeId(probeId)
+			, _mode("off")
+			, _setpoint(-100.0f)
+			, _model(model)
+			, _feedForwardEnabled(true)
+			, _estimator(model)
+			, _modelLearningEnabled(true)
+			, _lastTemp(0.0f)
+			, _lastTempValid(false)
+			, _profilePending(false)
+			, _cascadeTarget(-100.0f)
+			, _minOffset(0.0f)
+			, _maxOffset(0.0f)
+			, _deadTimeEnabled(false)
+			, _deadTime(0.0f)
+			, _deadTimeProcessGain(0.0f)
+			, _deadTimeTimeConstant(0.0f)
+{
+}
+
+// configurePID
+void VesselController::configurePID( f32 setpoint ) {
+	MutexLocker locker(_lock);
+
+	stopProfile();
+
+	_setpoint = setpoint;
+	_mode = "pid";
+	_currentLimiter.enablePin(_safetyPin);
+}
+
+// configurePWM
+void VesselController::configurePWM( f32 load ) {
+	MutexLocker locker(_lock);
+
+	stopProfile();
+
+	_mode = "pwm";
+	setElementLoad(load);
+	_currentLimiter.enablePin(_safetyPin);
+}
+
+// configureCascade
+void VesselController::configureCascade( f32 target, const StringId& outerProbeId, f32 minOffset, f32 maxOffset ) {
+	MutexLocker locker(_lock);
+
+	if (minOffset > maxOffset) {
+		throw RollerException("Cascade min offset (%.2f) exceeds max offset (%.2f)", minOffset, maxOffset);
+	}
+
+	stopProfile();
+
+	// changing the outer loop's limits or probe requires a new outer PID
+	if (_mode != "cascade" || outerProbeId != _outerProbeId
+			|| minOffset != _minOffset || maxOffset != _maxOffset) {
+		_outerPid.reset();
+	}
+
+	_cascadeTarget = target;
+	_outerProbeId = outerProbeId;
+	_minOffset = minOffset;
+	_maxOffset = maxOffset;
+
+	// start the inner loop at the lowest offset until the outer loop has run
+	if (_mode != "cascade") {
+		_setpoint = target + minOffset;
+	}
+
+	_mode = "cascade";
+	_currentLimiter.enablePin(_safetyPin);
+}
+
+// configureMPC
+void VesselController::configureMPC( f32 target ) {
+	MutexLocker locker(_lock);
+
+	stopProfile();
+
+	// the element stays off until the planner has run
+	if (_mode != "mpc") {
+		_plannedLoad = PlannedLoad();
+	}
+
+	_setpoint = target;
+	_mode = "mpc";
+	_currentLimiter.enablePin(_safetyPin);
+}
+
+// turnOff
+void VesselController::turnOff() {
+	MutexLocker locker(_lock);
+
+	Log::i("Turning off %s", _id.c_str());
+
+	stopProfile();
+	_mode = "off";
+
+	// set pwm load to 0
+	setElementLoad(0.0f);
+
+	// disable safety
+	_currentLimiter.disablePin(_safetyPin);
+}
+
+// getId
+const std::string& VesselController::getId() const {
+	return _id;
+}
+
+// getMode
+std::string VesselController::getMode() const {
+	MutexLocker locker(_lock);
+	return _mode;
+}
+
+// isPidEnabled
+bool VesselController::isPidEnabled() const {
+	MutexLocker locker(_lock);
+	return (_mode == "pid" || _mode == "cascade" || _mode == "mpc");
+}
+
+// isMPCEnabled
+bool VesselController::isMPCEnabled() const {
+	MutexLocker locker(_lock);
+	return (_mode == "mpc");
+}
+
+// isCascadeEnabled
+bool VesselController::isCascadeEnabled() const {
+	MutexLocker locker(_lock);
+	return (_mode == "cascade");
+}
+
+// getOuterProbeId
+StringId VesselController::getOuterProbeId() const {
+	MutexLocker locker(_lock);
+	return _outerProbeId;
+}
+
+// getSetpoint
+f32 VesselController::getSetpoint() const {
+	MutexLocker locker(_lock);
+	return _setpoint;
+}
+
+// getElementPin
+uint32_t VesselController::getElementPin() const {
+	return _elementPin;
+}
+
+// getProbeId
+const StringId& VesselController::getProbeId() const {
+	return _probeId;
+}
+
+// setThermalModel
+void VesselController::setThermalModel( const ThermalModel& model ) {
+	MutexLocker locker(_lock);
+	_model = model;
+
+	// a configured model is the new starting point for identification
+	_estimator.reset(_model);
+}
+
+// getThermalModel
+ThermalModel VesselController::getThermalModel() const {
+	MutexLocker locker(_lock);
+	return _model;
+}
+
+// setModelLearningEnabled
+void VesselController::setModelLearningEnabled( bool enabled ) {
+	MutexLocker locker(_lock);
+	_modelLearningEnabled = enabled;
+}
+
+// isModelLearningEnabled
+bool VesselController::isModelLearningEnabled() const {
+	MutexLocker locker(_lock);
+	return _modelLearningEnabled;
+}
+
+// setFeedForwardEnabled
+void VesselController::setFeedForwardEnabled( bool enabled ) {
+	MutexLocker locker(_lock);
+	_feedForwardEnabled = enabled;
+}
+
+// isFeedForwardEnabled
+bool VesselController::isFeedForwardEnabled() const {
+	MutexLocker locker(_lock);
+	return _feedForwardEnabled;
+}
+
+// startProfile
+void VesselController::startProfile( const std::vector<ProfileStep>& steps, f32 tolerance ) {
+	MutexLocker locker(_lock);
+
+	if (steps.empty()) {
+		throw RollerException("Cannot start a profile for %s with no steps", _id.c_str());
+	}
+
+	// the profile starts from the measured temperature, which we only know
+	// once the control loop runs
+	_profile.stop();
+	_profile.setTolerance(tolerance);
+	_pendingProfileSteps = steps;
+	_profilePending = true;
+
+	if (_mode != "pid" && _mode != "cascade") {
+		_setpoint = steps.front()._target;
+		_mode = "pid";
+		_currentLimiter.enablePin(_safetyPin);
+	}
+}
+
+// stopProfile
+void VesselController::stopProfile() {
+	MutexLocker locker(_lock);
+
+	_profile.stop();
+	_profilePending = false;
+}
+
+// setGainSchedule
+void VesselController::setGainSchedule( const GainSchedule& gainSchedule ) {
+	MutexLocker locker(_lock);
+
+	_gainSchedule = gainSchedule;
+
+	if (_pid) {
+		_pid->setGainSchedule(_gainSchedule);
+		if (_gainSchedule.isEmpty()) {
+			_pid->setTunings(AB_VESSEL_KP, AB_VESSEL_KI, AB_VESSEL_KD);
+			_pid->setErrorAccumulationCap(AB_VESSEL_INTEGRAL_CAP);
+		}
+	}
+}
+
+// setDeadTimeCompensation
+void VesselController::setDeadTimeCompensation( bool enabled, f32 deadTime, f32 processGain, f32 timeConstant ) {
+	MutexLocker locker(_lock);
+
+	if (deadTime < 0.0f || processGain < 0.0f || timeConstant < 0.0f) {
+		throw RollerException("Dead time compensation parameters must not be negative");
+	}
+
+	_deadTimeEnabled = enabled;
+	_deadTime = deadTime;
+	_deadTimeProcessGain = processGain;
+	_deadTimeTimeConstant = timeConstant;
+}
+
+// setDisturbanceRule
+void VesselController::setDisturbanceRule( const DisturbanceRule& rule ) {
+	MutexLocker locker(_lock);
+
+	if (rule._duration < 0.0f || rule._gainScale < 0.0f) {
+		throw RollerException("Disturbance duration and gain scale must not be negative");
+	}
+
+	_disturbances.setRule(rule);
+}
+
+// removeDisturbanceRule
+void VesselController::removeDisturbanceRule( const std::string& source ) {
+	MutexLocker locker(_lock);
+	_disturbances.removeRule(source);
+}
+
+// onDisturbance
+void VesselController::onDisturbance( const std::string& source ) {
+	MutexLocker locker(_lock);
+
+	// only matters while a PID is running
+	if (_mode == "pid" || _mode == "cascade" || _mode == "mpc") {
+		_disturbances.trigger(source);
+	}
+}
+
+// updateOuter
+void VesselController::updateOuter( f32 outerTemp, f32 dt ) {
+	MutexLocker locker(_lock);
+
+	if (_mode != "cascade") {
+		if (_outerPid) {
+			Log::i("killing %s cascade pid...", _id.c_str());
+			_outerPid.reset();
+		}
+		return;
+	}
+
+	// initialize outer PID if needed. its output is the offset of the inner
+	// setpoint from the target, so it is bounded by the offset limits.
+	if (! _outerPid) {
+		_outerPid.reset(new PID(AB_CASCADE_KP, AB_CASCADE_KI, AB_CASCADE_KD, _cascadeTarget, _minOffset, _maxOffset));
+		_outerPid->setErrorAccumulationCap(std::max(std::fabs(_minOffset), std::fabs(_maxOffset)) / AB_CASCADE_KI);
+	}
+
+	// a profile drives the outer target in cascade mode
+	if (_profilePending) {
+		_profile.start(_pendingProfileSteps, outerTemp);
+		_profilePending = false;
+	}
+	if (_profile.isActive()) {
+		_cascadeTarget = _profile.update(outerTemp, dt);
+	}
+
+	_outerPid->setSetpoint(_cascadeTarget);
+	f32 offset = _outerPid->update(outerTemp, dt);
+
+	_setpoint = _cascadeTarget + offset;
+}
+
+// getPlannerVessel
+bool VesselController::getPlannerVessel( PlannerVessel& vessel ) const {
+	MutexLocker locker(_lock);
+
+	if (_mode != "mpc" || ! _lastTempValid) {
+		return false;
+	}
+
+	vessel._model = _model;
+	vessel._temp = _lastTemp;
+	vessel._target = _setpoint;
+	vessel._milliAmps = (f32)_currentLimiter.getPinConfiguration(_elementPin)._milliAmps;
+	return true;
+}
+
+// setPlannedLoad
+void VesselController::setPlannedLoad( const PlannedLoad& plannedLoad ) {
+	MutexLocker locker(_lock);
+	_plannedLoad = plannedLoad;
+}
+
+// observe
+void VesselController::observe( f32 temp, f32 dt ) {
+	MutexLocker locker(_lock);
+
+	// the element only delivers power while its safety relay is closed
+	f32 load = 0.0f;
+	if (_currentLimiter.getPinState(_safetyPin)._enabled) {
+		load = _currentLimiter.getPinState(_elementPin)._pwmLoad;
+	}
+
+	_estimator.addSample(temp, load * _model.getElementWatts(), dt);
+	if (_modelLearningEnabled && _estimator.isConverged()) {
+		_model = _estimator.apply(_model);
+	}
+
+	_lastTemp = temp;
+	_lastTempValid = true;
+}
+
+// update
+void VesselController::update( f32 temp, f32 dt ) {
+	MutexLocker locker(_lock);
+
+	if (_mode != "pid" && _mode != "cascade" && _mode != "mpc") {
+		if (_pid) {
+			Log::i("killing %s pid...", _id.c_str());
+			_pid.reset();
+			_smithPredictor.reset();
+		}
+		return;
+	}
+
+	// initialize PID if needed
+	if (! _pid) {
+		_pid.reset(new PID(AB_VESSEL_KP, AB_VESSEL_KI, AB_VESSEL_KD, _setpoint, AB_VESSEL_MIN_LOAD, AB_VESSEL_MAX_LOAD));
+		_pid->setErrorAccumulationCap(AB_VESSEL_INTEGRAL_CAP);
+		_pid->setTrackingGain(AB_VESSEL_TRACKING_GAIN);
+		_pid->setGainSchedule(_gainSchedule);
+		_smithPredictor.reset();
+	}
+
+	// a profile drives the setpoint directly in pid mode
+	if (_mode == "pid") {
+		if (_profilePending) {
+			_profile.start(_pendingProfileSteps, temp);
+			_profilePending = false;
+		}
+		if (_profile.isActive()) {
+			_setpoint = _profile.update(temp, dt);
+		}
+	}
+
+	_pid->setSetpoint(_setpoint);
+
+	// feed-forward: what the model says it takes to hold (and move) the setpoint.
+	// only a profile's ramp counts as motion; setpoint steps and the cascade's
+	// nudges of the inner setpoint are left to the PID
+	f32 feedForward = 0.0f;
+	if (_feedForwardEnabled) {
+		f32 setpointRate = (_profile.isActive() ? _profile.getRampRate() : 0.0f);
+		feedForward = _model.getFeedForwardLoad(_setpoint, setpointRate) * 100.0f;
+	}
+
+	// get ahead of known disturbances, then let them decay
+	_pid->setFeedForward(feedForward + _disturbances.getBump());
+	_pid->setGainScale(_disturbances.getGainScale());
+	_disturbances.update(dt);
+
+	// wrap or unwrap the PID for dead time compensation
+	if (_deadTimeEnabled && ! _smithPredictor) {
+		_smithPredictor.reset(new SmithPredictor(_pid, getDeadTimeProcessGain(), getDeadTimeTimeConstant(), _deadTime));
+	} else if (! _deadTimeEnabled && _smithPredictor) {
+		_smithPredictor.reset();
+	}
+
+	if (_smithPredictor) {
+		// the model may have been reconfigured (or re-derived) since last cycle
+		_smithPredictor->setModel(getDeadTimeProcessGain(), getDeadTimeTimeConstant(), _deadTime);
+		_smithPredictor->update(temp, dt);
+	} else {
+		_pid->update(temp, dt);
+	}
+
+	// while heating up under the planner, the planned load is the most the
+	// element gets; once holding, the PID has the element to itself
+	f32 load = std::max(0.0f, (_pid->getOutput() / 100.0f));
+	if (_mode == "mpc" && ! _plannedLoad._holding) {
+		load = std::min(load, _plannedLoad._load);
+	}
+
+	// let the PID know what the limiter actually applied so it doesn't wind up
+	f32 applied = setElementLoad(load);
+	if (_smithPredictor) {
+		_smithPredictor->setAppliedOutput(applied * 100.0f);
+	} else {
+		_pid->setAppliedOutput(applied * 100.0f);
+	}
+}
+
+// setElementLoad
+f32 VesselController::setElementLoad( f32 load ) {
+
+	// TODO: review / optimize -- this triggers a lot of work
+	CurrentLimiter::PinConfiguration pinConfiguration = _currentLimiter.getPinConfiguration(_elementPin);
+	pinConfiguration._pwmLoad = load;
+	_currentLimiter.updatePinConfiguration(pinConfiguration);
+
+	return _currentLimiter.getPinState(_elementPin)._pwmLoad;
+}
+
+// getDeadTimeProcessGain
+f32 VesselController::getDeadTimeProcessGain() const {
+	if (_deadTimeProcessGain > 0.0f) {
+		return _deadTimeProcessGain;
+	}
+
+	// model gain is per unit load, PID output is in percent
+	return (_model.getProcessGain() / 100.0f);
+}
+
+// getDeadTimeTimeConstant
+f32 VesselController::getDeadTimeTimeConstant() const {
+	if (_deadTimeTimeConstant > 0.0f) {
+		return _deadTimeTimeConstant;
+	}
+
+	return _model.getTimeConstant();
+}
+
+// getTargetTemp
+f32 VesselController::getTargetTemp() const {
+	if (_profile.isActive()) {
+		const std::vector<ProfileStep>& steps = _profile.getSteps();
+		return steps[std::min(_profile.getStepIndex(), steps.size() - 1)]._target;
+	}
+
+	return _setpoint;
+}
+
+// to_json
+void VesselController::to_json( json& j ) const {
+	MutexLocker locker(_lock);
+
+	j = json {
+		{"pid", (_mode == "pid" || _mode == "cascade" || _mode == "mpc")},
+		{"setpoint", _setpoint},
+		{"model", _model},
+		{"feedForwardEnabled", _feedForwardEnabled},
+		{"modelLearningEnabled", _modelLearningEnabled},
+		{"estimator", _estimator}
+	};
+
+	// time to reach the target at full load (or with the element off, if
+	// cooling) and the load it takes to hold it, per the current model
+	if (_mode == "pid" || _mode == "cascade" || _mode == "mpc") {
+		f32 target = getTargetTemp();
+		j["expectedLoad"] = std::min(1.0f, _model.getSteadyStateLoad(target));
+		if (_lastTempValid) {
+			j["eta"] = _model.getTimeToTemp(_lastTemp, target, (target > _lastTemp ? 1.0f : 0.0f));
+		}
+	}
+
+	j["gainSchedule"] = _gainSchedule;
+	j["disturbance"] = _disturbances;
+	j["profile"] = _profile;
+	j["profile"]["pending"] = _profilePending;
+
+	if (_pid) {
+		j["output"] = _pid->getOutput();
+		j["feedForward"] = _pid->getFeedForward();
+		j["gains"] = json {
+			{"kp", _pid->getKp()},
+			{"ki", _pid->getKi()},
+			{"kd", _pid->getKd()},
+			{"errorAccumulationCap", _pid->getErrorAccumulationCap()}
+		};
+	}
+
+	j["deadTime"] = json {
+		{"enabled", _deadTimeEnabled},
+		{"deadTime", _deadTime},
+		{"processGain", getDeadTimeProcessGain()},
+		{"timeConstant", getDeadTimeTimeConstant()},
+		{"correction", (_smithPredictor ? _smithPredictor->getCorrection() : 0.0f)}
+	};
+
+	// the planner knows better, since it accounts for the shared budget
+	if (_mode == "mpc") {
+		j["plan"] = _plannedLoad;
+		j["eta"] = _plannedLoad._eta;
+	}
+
+	if (_mode == "cascade") {
+		j["cascade"] = json {
+			{"target", _cascadeTarget},
+			{"probe", _outerProbeId.getString()},
+			{"minOffset", _minOffset},
+			{"maxOffset", _maxOffset},
+			{"offset", (_setpoint - _cascadeTarget)}
+		};
+	}
+}
+
+// to_json
+void to_json( json& j, const VesselController& controller ) {
+	controller.to_json(j);
+}
@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <roller/core/types.h>
+#include <roller/core/log.h>
+
+#include "bounded_queue.h"
+#include "heat_up_planner.h"
+#include "pid.h"
+#include "pid_bank.h"
+#include "sample_filter.h"
+#include "thermal_model.h"
+#include "thermal_model_estimator.h"
+
+using namespace roller;
+
+#define AB_CHECKS_PID_TOLERANCE 0.001f // max output difference between a PIDBank lane and its PID
+#define AB_CHECKS_PLANNER_BUDGET 28000.0f // mA, less than the two elements draw together
+
+i32 g_failures = 0;
+
+// check
+void check( bool ok, const char* what ) {
+	if ( ! ok ) {
+		Log::w( "FAILED: %s", what );
+		g_failures++;
+	}
+}
+
+// checkPIDBank
+void checkPIDBank() {
+
+	// lanes with varied tunings and gain scales, half of them with back-calculation on
+	const size_t numLoops = 13;
+	std::vector<std::shared_ptr<PID>> pids;
+	PIDBank bank;
+	for ( size_t loop = 0; loop < numLoops; loop++ ) {
+		f32 kp = 5.0f + (f32)(loop % 5);
+		f32 ki = ((loop % 4) == 0 ? 0.0f : 0.25f * (f32)(loop % 4));
+		f32 kd = (f32)(loop % 3);
+		f32 setpoint = 40.0f + (f32)(loop % 11);
+		f32 trackingGain = ((loop % 2) == 0 ? 0.0f : 0.5f);
+		f32 gainScale = 1.0f + (0.5f * (f32)(loop % 3));
+
+		pids.push_back( std::make_shared<PID>( kp, ki, kd, setpoint, -100.0f, 100.0f ));
+		pids.back()->setErrorAccumulationCap( 1.0f + (f32)(loop % 3) );
+		pids.back()->setFeedForward( (f32)(loop % 6) );
+		pids.back()->setTrackingGain( trackingGain );
+		pids.back()->setGainScale( gainScale );
+
+		size_t index = bank.add( kp, ki, kd, setpoint, -100.0f, 100.0f );
+		bank.setErrorAccumulationCap( index, 1.0f + (f32)(loop % 3) );
+		bank.setFeedForward( index, (f32)(loop % 6) );
+		bank.setTrackingGain( index, trackingGain );
+		bank.setGainScale( index, gainScale );
+	}
+
+	std::vector<f32> inputs( numLoops );
+	f32 maxDiff = 0.0f;
+	for ( size_t step = 0; step < 2000; step++ ) {
+
+		// retune and move the setpoints part way through
+		if ( step == 700 ) {
+			for ( size_t loop = 0; loop < numLoops; loop += 3 ) {
+				pids[loop]->setTunings( 8.0f, 0.4f, 1.0f );
+				bank.setTunings( loop, 8.0f, 0.4f, 1.0f );
+				pids[loop]->setSetpoint( 65.0f );
+				bank.setSetpoint( loop, 65.0f );
+			}
+		}
+
+		// boost some lanes for a while, as after a disturbance
+		if ( step == 1200 || step == 1500 ) {
+			f32 gainScale = (step == 1200 ? 2.5f : 1.0f);
+			for ( size_t loop = 1; loop < numLoops; loop += 2 ) {
+				pids[loop]->setGainScale( gainScale );
+				bank.setGainScale( loop, gainScale );
+			}
+		}
+
+		for ( size_t loop = 0; loop < numLoops; loop++ ) {
+			inputs[loop] = 20.0f + (0.02f * (f32)step) + (2.0f * std::sin( (f32)(step + loop) * 0.05f ));
+		}
+
+		bank.update( inputs.data(), 0.333f );
+
+		for ( size_t loop = 0; loop < numLoops; loop++ ) {
+			f32 output = pids[loop]->update( inputs[loop], 0.333f );
+			maxDiff = std::max( maxDiff, std::fabs( output - bank.getOutput( loop )));
+
+			// a limiter holding some of the loops back
+			if ( (loop + step) % 3 == 0 ) {
+				f32 applied = std::min( std::max( 0.0f, output ), 30.0f );
+				pids[loop]->setAppliedOutput( applied );
+				bank.setAppliedOutput( loop, applied );
+			}
+		}
+	}
+
+	Log::i( "PIDBank (%s): max difference from PID %f", PIDBank::getImplementation(), maxDiff );
+	check( maxDiff <= AB_CHECKS_PID_TOLERANCE, "PIDBank output matches PID::update() lane for lane" );
+}
+
+// checkSampleFilter
+void checkSampleFilter() {
+
+	typedef SampleFilter::Result Result;
+
+	{
+		SampleFilter filter;
+		check( filter.add( 50000, 1000 ) == Result::ACCEPTED, "first sample is accepted" );
+		check( filter.getFiltered() == 50000 && filter.getFilteredTime() == 1000, "first sample is the filtered value" );
+		check( filter.add( 200000, 2000 ) == Result::OUT_OF_RANGE, "out of range sample is rejected" );
+		check( filter.add( 85000, 3000 ) == Result::POWER_ON_VALUE, "85 C far from the last sample is rejected" );
+	}
+
+	{
+		SampleFilter filter;
+		check( filter.add( 85000, 1000 ) == Result::POWER_ON_VALUE, "85 C first sample is held back" );
+		check( filter.add( 85000, 2000 ) == Result::ACCEPTED, "85 C first sample is accepted once confirmed" );
+		check( filter.getFiltered() == 85000, "confirmed 85 C is the filtered value" );
+	}
+
+	{
+		SampleFilter filter;
+		filter.add( 85000, 1000 );
+		check( filter.add( 21000, 2000 ) == Result::ACCEPTED, "sample after an unconfirmed 85 C is accepted" );
+		check( filter.getFiltered() == 21000, "unconfirmed 85 C is dropped" );
+	}
+
+	{
+		// a ramp, a spike the rate limit catches, and one it lets through
+		SampleFilter filter;
+		filter.add( 50000, 0 );
+		filter.add( 50100, 1000 );
+		filter.add( 50200, 2000 );
+		check( filter.getFiltered() == 50100 && filter.getFilteredTime() == 1000, "median of a ramp is the middle sample, at its time" );
+		check( filter.add( 90000, 3000 ) == Result::TOO_FAST, "jump faster than the rate limit is rejected" );
+		check( filter.add( 53000, 3000 ) == Result::ACCEPTED, "spike within the rate limit is accepted" );
+		check( filter.getFiltered() == 50200 && filter.getFilteredTime() == 2000, "median removes a single spike" );
+	}
+
+	{
+		// the probe moved: what keeps being rejected is taken to be real
+		SampleFilter filter;
+		filter.add( 20000, 0 );
+		for ( i32 i = 1; i <= 3; i++ ) {
+			check( filter.add( 80000, i * 1000 ) == Result::TOO_FAST, "jump is rejected until the filter starts over" );
+		}
+		check( filter.add( 80000, 4000 ) == Result::ACCEPTED, "filter starts over after consecutive rejections" );
+		check( filter.getFiltered() == 80000, "filter follows the new level" );
+	}
+}
+
+// checkThermalModelEstimator
+void checkThermalModelEstimator() {
+
+	// a simulated 40 kg vessel, learned from a prior that is well off
+	ThermalModel truth( 40.0f, 5500.0f, 10.0f, 20.0f );
+	ThermalModel prior( 25.0f, 5500.0f, 4.0f, 20.0f );
+	ThermalModelEstimator estimator( prior );
+
+	const f64 dt = 0.333;
+	const f64 loads[] = { 0.6, 0.0, 0.25, 0.0, 0.4, 0.1, 0.0, 0.2 };
+	f64 temp = 20.0;
+	f64 maxTemp = temp;
+	bool convergedEarly = false;
+	i32 steps = (i32)((3.0 * 3600.0) / dt);
+	for ( i32 i = 0; i < steps; i++ ) {
+		f64 power = loads[((i32)((i * dt) / 1200.0)) % 8] * truth.getElementWatts();
+		temp += dt * (power - (truth.getLossCoefficient() * (temp - truth.getAmbientTemp()))) / truth.getHeatCapacity();
+		maxTemp = std::max( maxTemp, temp );
+
+		// what a 12 bit probe reads
+		estimator.addSample( (f32)(std::round( temp / 0.0625 ) * 0.0625), (f32)power, (f32)dt );
+		if ( i * dt < 120.0 && estimator.isConverged() ) {
+			convergedEarly = true;
+		}
+	}
+
+	f32 capacityError = std::fabs( estimator.getHeatCapacity() - truth.getHeatCapacity() ) / truth.getHeatCapacity();
+	f32 lossError = std::fabs( estimator.getLossCoefficient() - truth.getLossCoefficient() ) / truth.getLossCoefficient();
+	Log::i( "ThermalModelEstimator: heat capacity off by %.2f%%, loss coefficient by %.2f%% (max %.1f C)",
+			capacityError * 100.0f, lossError * 100.0f, maxTemp );
+
+	check( ! convergedEarly, "estimator doesn't claim convergence before enough updates" );
+	check( estimator.isConverged(), "estimator converges on a simulated vessel" );
+	check( capacityError < 0.05f, "estimated heat capacity is within 5% of the vessel's" );
+	check( lossError < 0.2f, "estimated loss coefficient is within 20% of the vessel's" );
+
+	ThermalModel applied = estimator.apply( prior );
+	check( std::fabs( applied.getLiquidMass() - truth.getLiquidMass() ) < 0.05f * truth.getLiquidMass()
+			&& applied.getLossCoefficient() == estimator.getLossCoefficient()
+			&& applied.getElementWatts() == prior.getElementWatts(),
+			"apply() takes mass and losses from the estimate and keeps the rest" );
+}
+
+// checkHeatUpPlanner
+void checkHeatUpPlanner() {
+
+	HeatUpPlanner planner;
+	f32 step = planner.getStepDuration();
+
+	// a big HLT and a small boil kettle, each with a 23 A element
+	std::vector<PlannerVessel> initial( 2 );
+	initial[0]._model = ThermalModel( 60.0f, 5500.0f, 8.0f, 20.0f );
+	initial[0]._temp = 15.0f;
+	initial[0]._target = 76.0f;
+	initial[0]._milliAmps = 23000.0f;
+	initial[1]._model = ThermalModel( 20.0f, 5500.0f, 5.0f, 20.0f );
+	initial[1]._temp = 15.0f;
+	initial[1]._target = 66.0f;
+	initial[1]._milliAmps = 23000.0f;
+
+	{
+		// one vessel is nearly there: what it can't use goes to the other
+		std::vector<PlannerVessel> vessels = initial;
+		vessels[1]._temp = 64.0f;
+		std::vector<PlannedLoad> plan = planner.plan( vessels, AB_CHECKS_PLANNER_BUDGET );
+		f32 cap = vessels[1]._model.getLoadToReach( vessels[1]._temp, vessels[1]._target, step );
+		f32 used = (plan[0]._load * vessels[0]._milliAmps) + (plan[1]._load * vessels[1]._milliAmps);
+		check( plan[1]._load <= cap + 0.001f, "a vessel close to target is capped at the load that lands on it" );
+		check( std::fabs( used - AB_CHECKS_PLANNER_BUDGET ) < 1.0f, "what a capped vessel can't use goes to the other" );
+	}
+
+	{
+		// one vessel is holding: it gets its holding load, the other the rest
+		std::vector<PlannerVessel> vessels = initial;
+		vessels[1]._temp = vessels[1]._target;
+		std::vector<PlannedLoad> plan = planner.plan( vessels, AB_CHECKS_PLANNER_BUDGET );
+		f32 holdingLoad = vessels[1]._model.getSteadyStateLoad( vessels[1]._target );
+		f32 rest = (AB_CHECKS_PLANNER_BUDGET - (holdingLoad * vessels[1]._milliAmps)) / vessels[0]._milliAmps;
+		check( plan[1]._holding && std::fabs( plan[1]._load - holdingLoad ) < 0.001f, "a vessel at target only gets its holding load" );
+		check( std::fabs( plan[0]._load - std::min( 1.0f, rest )) < 0.001f, "the vessel still heating gets the rest of the budget" );
+	}
+
+	// heat both up, planned every step, and the way the limiter would: both
+	// elements asking for the load that lands them on target, scaled down
+	// together until they fit the budget
+	f32 planned[2] = { -1.0f, -1.0f };
+	f32 scaled[2] = { -1.0f, -1.0f };
+	f32 maxMilliAmps = 0.0f;
+	f32 maxOvershoot = -100.0f;
+	f32 plannedEta = 0.0f;
+	std::vector<PlannerVessel> vessels = initial;
+	std::vector<PlannerVessel> scaledVessels = initial;
+	for ( i32 i = 0; i < 400; i++ ) {
+		f32 time = (f32)i * step;
+
+		std::vector<PlannedLoad> plan = planner.plan( vessels, AB_CHECKS_PLANNER_BUDGET );
+		if ( i == 0 ) {
+			plannedEta = std::max( plan[0]._eta, plan[1]._eta );
+		}
+
+		f32 milliAmps = 0.0f;
+		f32 wanted = 0.0f;
+		std::vector<f32> scaledLoads( 2 );
+		for ( size_t v = 0; v < 2; v++ ) {
+			milliAmps += plan[v]._load * vessels[v]._milliAmps;
+			const ThermalModel& model = scaledVessels[v]._model;
+			scaledLoads[v] = std::min( 1.0f, std::max( 0.0f, model.getLoadToReach( scaledVessels[v]._temp, scaledVessels[v]._target, step )));
+			wanted += scaledLoads[v] * scaledVessels[v]._milliAmps;
+		}
+		maxMilliAmps = std::max( maxMilliAmps, milliAmps );
+		f32 scale = (wanted > AB_CHECKS_PLANNER_BUDGET ? AB_CHECKS_PLANNER_BUDGET / wanted : 1.0f);
+
+		for ( size_t v = 0; v < 2; v++ ) {
+			f32 reached = vessels[v]._target - planner.getHoldingTolerance();
+
+			vessels[v]._temp = vessels[v]._model.getTempAfter( vessels[v]._temp, plan[v]._load, step );
+			maxOvershoot = std::max( maxOvershoot, vessels[v]._temp - vessels[v]._target );
+			if ( planned[v] < 0.0f && vessels[v]._temp >= reached ) {
+				planned[v] = time + step;
+			}
+
+			scaledVessels[v]._temp = scaledVessels[v]._model.getTempAfter( scaledVessels[v]._temp, scaledLoads[v] * scale, step );
+			if ( scaled[v] < 0.0f && scaledVessels[v]._temp >= reached ) {
+				scaled[v] = time + step;
+			}
+		}
+	}
+
+	Log::i( "HeatUpPlanner: planned ETAs %.0f s and %.0f s (predicted %.0f s), scaled %.0f s and %.0f s",
+			planned[0], planned[1], plannedEta, scaled[0], scaled[1] );
+
+	check( maxMilliAmps <= AB_CHECKS_PLANNER_BUDGET + 1.0f, "planned loads never draw more than the budget" );
+	check( maxOvershoot <= 0.01f, "no vessel is planned past its target" );
+	check( planned[0] >= 0.0f && planned[1] >= 0.0f && scaled[0] >= 0.0f && scaled[1] >= 0.0f, "both vessels reach their targets" );
+	// total ETA is the time until both are at target, which is what the planner minimizes
+	f32 plannedTotal = std::max( planned[0], planned[1] );
+	f32 scaledTotal = std::max( scaled[0], scaled[1] );
+	check( plannedTotal + step < scaledTotal, "the planned split beats proportional scaling on total ETA" );
+	check( std::fabs( plannedEta - plannedTotal ) <= 2.0f * step, "the planner's ETA matches the heat up" );
+}
+
+// checkBoundedQueue
+void checkBoundedQueue() {
+
+	{
+		BoundedQueue<i32> queue( 5 );
+		check( queue.getCapacity() == 8, "capacity is rounded up to a power of two" );
+
+		i32 value = 0;
+		check( ! queue.pop( value ), "pop from an empty queue fails" );
+
+		for ( i32 i = 0; i < 8; i++ ) {
+			queue.push( i );
+		}
+		check( ! queue.push( 8 ), "push to a full queue fails" );
+
+		// keep it half full so the positions wrap around the cells many times
+		bool ordered = true;
+		i32 expected = 0;
+		for ( i32 i = 8; i < 1000; i++ ) {
+			ordered = (ordered && queue.pop( value ) && value == expected++);
+			ordered = (ordered && queue.push( i ));
+		}
+		while ( queue.pop( value )) {
+			ordered = (ordered && value == expected++);
+		}
+		check( ordered && expected == 1000, "elements come out in order across wraparound" );
+	}
+
+	{
+		// two producers and two consumers; every element comes out exactly once
+		const i32 perProducer = 100000;
+		BoundedQueue<i32> queue( 64 );
+		std::atomic<i64> sum( 0 );
+		std::atomic<i32> popped( 0 );
+
+		std::vector<std::thread> threads;
+		for ( i32 producer = 0; producer < 2; producer++ ) {
+			threads.emplace_back( [&queue, producer, perProducer]() {
+				for ( i32 i = 1; i <= perProducer; i++ ) {
+					while ( ! queue.push( producer * perProducer + i )) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for ( i32 consumer = 0; consumer < 2; consumer++ ) {
+			threads.emplace_back( [&queue, &sum, &popped, perProducer]() {
+				i32 value;
+				while ( popped.load() < 2 * perProducer ) {
+					if ( queue.pop( value )) {
+						sum += value;
+						popped++;
+					} else {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for ( auto& thread : threads ) {
+			thread.join();
+		}
+
+		i64 n = 2 * (i64)perProducer;
+		check( sum.load() == n * (n + 1) / 2, "every element is popped exactly once with concurrent producers and consumers" );
+	}
+}
+
+// main
+i32 main( i32 argc, char** argv ) {
+
+	Log::setLogLevelMode( LOG_LEVEL_MODE_UNIX_TERMINAL );
+
+	checkPIDBank();
+	checkSampleFilter();
+	checkThermalModelEstimator();
+	checkHeatUpPlanner();
+	checkBoundedQueue();
+
+	if ( g_failures > 0 ) {
+		Log::w( "%d checks failed", g_failures );
+		return 1;
+	}
+
+	Log::i( "All checks passed" );
+	return 0;
+}
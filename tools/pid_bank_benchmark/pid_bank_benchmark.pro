@@ -0,0 +1,39 @@
+CONFIG += debug
+QMAKE_CXXFLAGS += -std=c++11
+QT -= core gui
+
+# this will force the makefile to use colorgcc, a wrapper around gcc that colorizes content.
+# install on ubuntu with "sudo apt-get install colorgcc"
+# or comment out to use straight gcc.
+QMAKE_CXX = colorgcc
+
+INCLUDEPATH += include/ \
+		../../core/include \
+		../../../roller/include \
+
+LIBS += -lboost_program_options \
+
+debug:LIBS += -L../../core/debug/ -lab2_core \
+		-L../../../roller/core/debug/ -lroller_core \
+
+release:LIBS +=  -L../../core/release/ -lab2_core \
+		-L../../../roller/core/release/ -lroller_core \
+
+SOURCES = $$files(src/*.cpp) \
+
+HEADERS = $$files(include/*.h) \
+
+QMAKE_RPATHDIR += "../../core/debug/" \
+		"../../../roller/core/debug/" \
+
+release:DESTDIR = release
+release:OBJECTS_DIR = release/.obj
+release:MOC_DIR = release/.moc
+release:RCC_DIR = release/.rcc
+release:UI_DIR = release/.ui
+
+debug:DESTDIR = debug
+debug:OBJECTS_DIR = debug/.obj
+debug:MOC_DIR = debug/.moc
+debug:RCC_DIR = debug/.rcc
+debug:UI_DIR = debug/.ui
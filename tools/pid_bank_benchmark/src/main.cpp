@@ -0,0 +1,127 @@
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <roller/core/types.h>
+#include <roller/core/log.h>
+#include <roller/core/util.h>
+
+#include "pid.h"
+#include "pid_bank.h"
+
+using namespace roller;
+namespace po = boost::program_options;
+
+// simulated process input for a loop at a given step
+f32 simulatedInput( size_t loop, size_t step ) {
+	return 20.0f + (0.5f * (f32)(loop % 7)) + (0.01f * (f32)step) + std::sin( (f32)(step + loop) * 0.1f );
+}
+
+// main
+i32 main( i32 argc, char** argv ) {
+
+	size_t numLoops;
+	size_t iterations;
+	f32 dt;
+	f32 tolerance;
+
+	po::options_description mainOptions( "Main options" );
+	mainOptions.add_options()
+		("help,h",																		"produce this help message")
+		("loops,n",			po::value<size_t>(&numLoops)->default_value(64),			"number of control loops")
+		("iterations,i",	po::value<size_t>(&iterations)->default_value(100000),		"number of updates to time")
+		("dt",				po::value<f32>(&dt)->default_value(0.333f),					"delta time per update (s)")
+		("tolerance,t",		po::value<f32>(&tolerance)->default_value(0.001f),			"max allowed output difference")
+		;
+
+	po::variables_map mainOptionsMap;
+	po::store( po::parse_command_line( argc, argv, mainOptions ), mainOptionsMap );
+
+	if ( mainOptionsMap.count( "help" )) {
+		std::cout << mainOptions << std::endl;
+		return 0;
+	}
+
+	po::notify( mainOptionsMap );
+
+	Log::setLogLevelMode( LOG_LEVEL_MODE_UNIX_TERMINAL );
+
+	// build identical scalar PIDs and bank loops with varied tunings
+	std::vector<std::shared_ptr<PID>> pids;
+	PIDBank bank;
+	for ( size_t loop = 0; loop < numLoops; loop++ ) {
+		f32 kp = 10.0f + (f32)(loop % 5);
+		f32 ki = ((loop % 4) == 0 ? 0.0f : 0.5f * (f32)(loop % 4));
+		f32 kd = 1.0f + (f32)(loop % 3);
+		f32 setpoint = 40.0f + (f32)(loop % 11);
+
+		pids.push_back( std::make_shared<PID>( kp, ki, kd, setpoint, -100.0f, 100.0f ));
+		pids.back()->setErrorAccumulationCap( 1.5f + (f32)(loop % 3) );
+		pids.back()->setFeedForward( (f32)(loop % 6) );
+		pids.back()->setTrackingGain( 0.5f );
+
+		size_t index = bank.add( kp, ki, kd, setpoint, -100.0f, 100.0f );
+		bank.setErrorAccumulationCap( index, 1.5f + (f32)(loop % 3) );
+		bank.setFeedForward( index, (f32)(loop % 6) );
+		bank.setTrackingGain( index, 0.5f );
+	}
+
+	Log::i( "PIDBank implementation: %s", PIDBank::getImplementation() );
+	Log::i( "Loops: %zu, iterations: %zu", numLoops, iterations );
+
+	// verify the bank against the scalar PIDs, including limiter feedback
+	std::vector<f32> inputs( numLoops );
+	f32 maxDiff = 0.0f;
+	size_t verifySteps = std::min( iterations, (size_t)1000 );
+	for ( size_t step = 0; step < verifySteps; step++ ) {
+		for ( size_t loop = 0; loop < numLoops; loop++ ) {
+			inputs[loop] = simulatedInput( loop, step );
+		}
+
+		bank.update( inputs.data(), dt );
+
+		for ( size_t loop = 0; loop < numLoops; loop++ ) {
+			f32 output = pids[loop]->update( inputs[loop], dt );
+			maxDiff = std::max( maxDiff, std::fabs( output - bank.getOutput( loop )));
+
+			// pretend a limiter scaled every other loop back
+			if ( (loop + step) % 2 == 0 ) {
+				f32 applied = std::max( 0.0f, output ) * 0.5f;
+				pids[loop]->setAppliedOutput( applied );
+				bank.setAppliedOutput( loop, applied );
+			}
+		}
+	}
+
+	Log::i( "Max output difference over %zu steps: %f", verifySteps, maxDiff );
+	if ( maxDiff > tolerance ) {
+		Log::w( "PIDBank output differs from PID by more than %f", tolerance );
+		return 1;
+	}
+
+	// time the bank
+	i64 start = getTimeMicros();
+	for ( size_t step = 0; step < iterations; step++ ) {
+		inputs[step % numLoops] += 0.001f;
+		bank.update( inputs.data(), dt );
+	}
+	i64 bankMicros = std::max( (i64)1, getTimeMicros() - start );
+
+	// time the scalar PIDs
+	start = getTimeMicros();
+	for ( size_t step = 0; step < iterations; step++ ) {
+		inputs[step % numLoops] += 0.001f;
+		for ( size_t loop = 0; loop < numLoops; loop++ ) {
+			pids[loop]->update( inputs[loop], dt );
+		}
+	}
+	i64 scalarMicros = std::max( (i64)1, getTimeMicros() - start );
+
+	f64 loopUpdates = (f64)numLoops * (f64)iterations;
+	Log::i( "PIDBank: %lld us, %.2f loops/us", bankMicros, loopUpdates / (f64)bankMicros );
+	Log::i( "PID:     %lld us, %.2f loops/us", scalarMicros, loopUpdates / (f64)scalarMicros );
+
+	return 0;
+}
@@ -122,8 +122,7 @@ i32 main( i32 argc, char** argv ) {
 	Log::i( "Freq: %u", pwm.getFrequency() );
 	pwm.unpause();
 
-	i64 time = -1;
-	i32 temp = -1;
+	f32 temp = -1.0f;
 
 	i64 lastPIDUpdateTime = getTime();
 	i64 lastPrintTime = getTime() - 5000;
@@ -132,19 +131,21 @@ i32 main( i32 argc, char** argv ) {
 
 		try {
 
-			ProbeStats stats = tempManager.getProbeStats( probeId );
-			temp = stats._lastTemp;
+			// the loop runs faster than the probe; use the temperature
+			// extrapolated to now rather than the last sample
 			i64 now = getTime();
+			TemperatureEstimate estimate = tempManager.getEstimate( probeId, now );
+			temp = estimate._temp;
 
 			// print every 5s
 			if ( now - lastPrintTime > 5000 ) {
-				Log::i( "%lld : %d", now, temp );
+				Log::i( "%lld : %.3f (+/- %.3f, %.4f C/s)", now, temp, estimate._stdDev, estimate._slope );
 				Log::i( "PID: %f", pid.getOutput() );
 				lastPrintTime += 5000;
 			}
 
 			// update pid
-			pid.update( ((f32)temp / 1000.f), ((f32)(now - lastPIDUpdateTime) / 1000.0f) );
+			pid.update( temp, ((f32)(now - lastPIDUpdateTime) / 1000.0f) );
 			lastPIDUpdateTime = now;
 
 			pwm.setLoadCycle( (pid.getOutput() / 100.0f ));
@@ -2,7 +2,9 @@ TEMPLATE = subdirs
 
 CONFIG += ordered
 
-SUBDIRS = pid_temp_controller \
+SUBDIRS = core_checks \
+		pid_bank_benchmark \
+		pid_temp_controller \
 		pwm_temp_controller \
 		valve_controller \
 
@@ -386,6 +386,26 @@ function init() {
 								var pidStr = "PID: "+ pidValueStr +"("+ pwmStr +")";
 								console.log("Updating label to "+ pidStr);
 								label.setValue(pidStr);
+							} else if (type == "cascade") {
+								// Cascade -- show outer target and the setpoint it drives
+								// Label is: Cascade 152F (PID: 160F (PWM: 60% (50%)))
+								var targetF = pidJsonObj.cascade.target * 1.8 + 32;
+								var setpointF = pidJsonObj.setpoint * 1.8 + 32;
+								var cascadeStr = "Cascade "+ targetF.toFixed(1) + "\xB0F (PID: "
+										+ setpointF.toFixed(1) +"\xB0F ("+ pwmStr +"))";
+								console.log("Updating label to "+ cascadeStr);
+								label.setValue(cascadeStr);
+							} else if (type == "mpc") {
+								// MPC -- PID with a planned heat-up, show the ETA while heating
+								// Label is: MPC 170F, 25 min (PWM: 60% (50%))
+								var tempF = pidJsonObj.setpoint * 1.8 + 32;
+								var mpcStr = "MPC "+ tempF.toFixed(1) + "\xB0F";
+								if (pidJsonObj.plan && ! pidJsonObj.plan.holding && pidJsonObj.plan.eta >= 0) {
+									mpcStr += ", "+ Math.ceil(pidJsonObj.plan.eta / 60) +" min";
+								}
+								mpcStr += " ("+ pwmStr +")";
+								console.log("Updating label to "+ mpcStr);
+								label.setValue(mpcStr);
 							} else if (type == "pwm") {
 								// PWM -- show set and actual
 								// Label is: PWM: 60% (50%)